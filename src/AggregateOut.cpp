@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "AggregateOut.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+AggregateOut::AggregateOut(const std::string &path,
+                           std::ostream      &out,
+                           std::size_t        window,
+                           const std::string &name_prefix,
+                           float_format_t     float_format)
+    : MbOut(path, out, name_prefix, float_format), window(window) {
+    if (window == 0) throw std::invalid_argument("aggregation window must not be 0");
+
+    const auto n = signals.size();
+    min.resize(n);
+    max.resize(n);
+    sum.resize(n);
+    valid.resize(n);
+    last.resize(n);
+    kinds.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto kind = value_kind(signals[i]);
+        kinds.push_back(kind);
+        switch (kind) {
+            case value_kind_t::unsigned_int:
+            case value_kind_t::hex: unsigned_signals.push_back(i); break;
+            case value_kind_t::signed_int: signed_signals.push_back(i); break;
+            case value_kind_t::float32: float32_signals.push_back(i); break;
+            case value_kind_t::float64: float64_signals.push_back(i); break;
+            default: throw std::logic_error("unknown value kind");
+        }
+    }
+
+    reset();
+}
+
+void AggregateOut::reset() {
+    for (const auto i : unsigned_signals) {
+        min[i].u = std::numeric_limits<uint64_t>::max();
+        max[i].u = 0;
+    }
+    for (const auto i : signed_signals) {
+        min[i].i = std::numeric_limits<int64_t>::max();
+        max[i].i = std::numeric_limits<int64_t>::min();
+    }
+    for (const auto *float_signals : {&float32_signals, &float64_signals}) {
+        for (const auto i : *float_signals) {
+            min[i].f64 = std::numeric_limits<double>::infinity();
+            max[i].f64 = -std::numeric_limits<double>::infinity();
+        }
+    }
+    std::fill(sum.begin(), sum.end(), 0.0);
+    std::fill(valid.begin(), valid.end(), 0);
+    samples = 0;
+}
+
+/**
+ * \brief accumulate a float sample without branches (min/max instructions, NaN samples are ignored)
+ */
+static inline void accumulate_float(double d, value_t &min, value_t &max, double &sum, std::size_t &valid) {
+    // all comparisons with NaN are false (isnan() is an unordered compare)
+    const bool number = !std::isnan(d);
+    min.f64           = d < min.f64 ? d : min.f64;
+    max.f64           = d > max.f64 ? d : max.f64;
+    sum += number ? d : 0.0;
+    valid += number;
+}
+
+void AggregateOut::cycle() {
+    decode_signals();
+
+    // integers: min/max without conversion (64 bit values are not exact as double)
+    for (const auto i : unsigned_signals) {
+        const auto u = values[i].u;
+        min[i].u     = u < min[i].u ? u : min[i].u;
+        max[i].u     = u > max[i].u ? u : max[i].u;
+        sum[i] += static_cast<double>(u);
+    }
+    for (const auto i : signed_signals) {
+        const auto v = values[i].i;
+        min[i].i     = v < min[i].i ? v : min[i].i;
+        max[i].i     = v > max[i].i ? v : max[i].i;
+        sum[i] += static_cast<double>(v);
+    }
+    for (const auto i : float32_signals)
+        accumulate_float(static_cast<double>(values[i].f32), min[i], max[i], sum[i], valid[i]);
+    for (const auto i : float64_signals)
+        accumulate_float(values[i].f64, min[i], max[i], sum[i], valid[i]);
+
+    std::copy(values.begin(), values.end(), last.begin());
+
+    if (++samples >= window) {
+        output_window();
+        reset();
+    }
+
+    flush_output();
+}
+
+void AggregateOut::output_window() {
+    for (std::size_t i = 0; i < signals.size(); ++i) {
+        const auto &signal   = signals[i];
+        const bool  is_float = kinds[i] == value_kind_t::float32 || kinds[i] == value_kind_t::float64;
+        const auto  count    = is_float ? valid[i] : samples;
+
+        auto signal_min = min[i];
+        auto signal_max = max[i];
+        if (is_float && count == 0) {
+            signal_min.f64 = std::numeric_limits<double>::quiet_NaN();
+            signal_max.f64 = std::numeric_limits<double>::quiet_NaN();
+        }
+
+        // float32 min/max are samples: converting them back is exact
+        if (kinds[i] == value_kind_t::float32) {
+            signal_min.f32 = static_cast<float>(signal_min.f64);
+            signal_max.f32 = static_cast<float>(signal_max.f64);
+        }
+
+        const auto mean = count ? sum[i] / static_cast<double>(count) : std::numeric_limits<double>::quiet_NaN();
+
+        char  line[MAX_AGGREGATE_LINE_CHARS];
+        char *p = format_signal(line, signal, last[i]);
+        p[-1]   = ':';  // replace line break
+        p       = format_value(p, signal, signal_min);
+        *p++    = ':';
+        p       = format_value(p, signal, signal_max);
+        *p++    = ':';
+        p       = format::flt(p, mean, signal.float_format);
+        *p++    = ':';
+        p       = format::dec(p, count);
+        *p++    = '\n';
+        out_buffer.append(line, p);
+    }
+}
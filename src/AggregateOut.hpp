@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "MbOut.hpp"
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * \brief output aggregated signal values
+ *
+ * Each cycle samples all signals. At the end of each window (a number of cycles) one line per signal is written:
+ * <register type>:<index>[:<data type>]:<last>:<min>:<max>:<mean>:<sample count>
+ *
+ * NaN samples of float signals are not aggregated (not counted). If all samples of a window are NaN, min, max and mean
+ * are NaN.
+ */
+class AggregateOut : public MbOut {
+private:
+    /** maximum length of one output line */
+    static constexpr std::size_t MAX_AGGREGATE_LINE_CHARS = MAX_LINE_CHARS + 3 * MAX_VALUE_CHARS + 24;
+
+    // accumulators: one element per signal (min/max: member of the value kind, float32 as f64)
+    std::vector<value_t>      min;
+    std::vector<value_t>      max;
+    std::vector<double>       sum;
+    std::vector<std::size_t>  valid;  // samples that are not NaN (float signals)
+    std::vector<value_t>      last;
+    std::vector<value_kind_t> kinds;
+
+    // signals per value kind: each kind is accumulated in its own loop without branches
+    std::vector<std::size_t> unsigned_signals;  // unsigned and hex
+    std::vector<std::size_t> signed_signals;
+    std::vector<std::size_t> float32_signals;
+    std::vector<std::size_t> float64_signals;
+
+    std::size_t window;
+    std::size_t samples = 0;
+
+    void reset();
+    void output_window();
+
+protected:
+    [[nodiscard]] std::size_t max_cycle_output() const override {
+        return signals.size() * MAX_AGGREGATE_LINE_CHARS;
+    }
+
+public:
+    /**
+     * \brief create aggregate output
+     * @param path signal list
+     * @param out output stream
+     * @param window number of cycles per window
+     * @param name_prefix shared memory name prefix
+     * @param float_format default float output format
+     */
+    AggregateOut(const std::string &path,
+                 std::ostream      &out,
+                 std::size_t        window,
+                 const std::string &name_prefix  = "modbus_",
+                 float_format_t     float_format = float_format_t::scientific);
+
+    void cycle() override;
+};
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "ArchiveOut.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+ArchiveOut::ArchiveOut(const std::string &path,
+                       std::ostream      &out,
+                       const std::string &file,
+                       std::size_t        block_samples,
+                       const std::string &name_prefix,
+                       float_format_t     float_format)
+    : MbOut(path, out, name_prefix, float_format), block_samples(block_samples) {
+    if (block_samples == 0 || block_samples > std::numeric_limits<uint32_t>::max())
+        throw std::invalid_argument("invalid number of samples per block");
+    if (signals.size() > std::numeric_limits<uint32_t>::max() - 1)
+        throw std::runtime_error("too many signals for archive");
+
+    for (const auto &signal : signals) {
+        switch (value_kind(signal)) {
+            case value_kind_t::float32:
+                columns.push_back({true, float_columns.size()});
+                float_columns.emplace_back(32);
+                break;
+            case value_kind_t::float64:
+                columns.push_back({true, float_columns.size()});
+                float_columns.emplace_back(64);
+                break;
+            case value_kind_t::unsigned_int:
+            case value_kind_t::signed_int:
+            case value_kind_t::hex:
+                columns.push_back({false, integer_columns.size()});
+                integer_columns.emplace_back();
+                break;
+            default: throw std::logic_error("unknown value kind");
+        }
+    }
+
+    fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "failed to open '" + file + '\'');
+
+    archive_header_t header {};
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version       = ARCHIVE_VERSION;
+    header.signal_count  = static_cast<uint32_t>(signals.size());
+    header.block_samples = static_cast<uint32_t>(block_samples);
+
+    std::vector<archive_signal_t> descriptors(signals.size());
+    for (std::size_t i = 0; i < signals.size(); ++i) {
+        descriptors[i].register_type = static_cast<uint8_t>(signals[i].register_type);
+        descriptors[i].data_type     = static_cast<uint8_t>(signals[i].data_type);
+        descriptors[i].float_format  = static_cast<uint8_t>(signals[i].float_format);
+        descriptors[i].flags         = signals[i].scaled() ? ARCHIVE_SIGNAL_SCALED : 0;
+        descriptors[i].index         = signals[i].base_index;
+    }
+
+    offset = 0;
+    try {
+        write(&header, sizeof(header));
+        write(descriptors.data(), descriptors.size() * sizeof(archive_signal_t));
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+ArchiveOut::~ArchiveOut() {
+    try {
+        if (samples) write_block();
+
+        archive_trailer_t trailer {};
+        trailer.index_offset = offset;
+        trailer.block_count  = index.size();
+        memcpy(trailer.magic, ARCHIVE_INDEX_MAGIC, sizeof(trailer.magic));
+        write(index.data(), index.size() * sizeof(archive_index_entry_t));
+        write(&trailer, sizeof(trailer));
+    } catch (const std::exception &e) {
+        // the blocks that are already written can still be read (without index)
+        std::cerr << "WARNING: failed to close archive: " << e.what() << std::endl;
+    }
+    close(fd);
+}
+
+void ArchiveOut::write(const void *data, std::size_t size) {
+    const auto *ptr = static_cast<const uint8_t *>(data);
+    while (size) {
+        const auto ret = ::write(fd, ptr, size);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "failed to write archive");
+        }
+        ptr += ret;
+        size -= static_cast<std::size_t>(ret);
+        offset += static_cast<uint64_t>(ret);
+    }
+}
+
+void ArchiveOut::write_block() {
+    const auto column_count = signals.size() + 1;
+
+    std::vector<const archive::BitWriter *> writers;
+    writers.reserve(column_count);
+    writers.push_back(&timestamps.finish());
+    for (const auto &column : columns)
+        writers.push_back(column.is_float ? &float_columns[column.encoder].finish()
+                                          : &integer_columns[column.encoder].finish());
+
+    std::size_t size = sizeof(archive_block_header_t) + column_count * sizeof(uint32_t);
+    for (const auto *writer : writers)
+        size += writer->bytes().size();
+
+    archive_block_header_t header {};
+    header.magic    = ARCHIVE_BLOCK_MAGIC;
+    header.samples  = static_cast<uint32_t>(samples);
+    header.size     = size;
+    header.first_us = first_us;
+    header.last_us  = last_us;
+
+    block.resize(size);
+    auto *dst = block.data();
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    for (const auto *writer : writers) {
+        const auto column_size = static_cast<uint32_t>(writer->bytes().size());
+        memcpy(dst, &column_size, sizeof(column_size));
+        dst += sizeof(column_size);
+    }
+    for (const auto *writer : writers) {
+        memcpy(dst, writer->bytes().data(), writer->bytes().size());
+        dst += writer->bytes().size();
+    }
+
+    index.push_back({first_us, last_us, offset, static_cast<uint32_t>(samples), 0});
+    write(block.data(), block.size());
+
+    timestamps.clear();
+    for (auto &column : float_columns)
+        column.clear();
+    for (auto &column : integer_columns)
+        column.clear();
+    samples = 0;
+}
+
+void ArchiveOut::cycle() {
+    timespec ts {};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    const int64_t time_us = ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+    if (samples == 0) first_us = time_us;
+    last_us = time_us;
+    timestamps.add(time_us);
+    decode_signals();
+
+    for (std::size_t i = 0; i < signals.size(); ++i) {
+        const auto &signal = signals[i];
+        const auto &column = columns[i];
+        const auto  value  = values[i];
+        if (column.is_float) {
+            uint64_t bits;
+            if (value_kind(signal) == value_kind_t::float32) {
+                uint32_t bits32;
+                memcpy(&bits32, &value.f32, sizeof(bits32));
+                bits = bits32;
+            } else {
+                memcpy(&bits, &value.f64, sizeof(bits));
+            }
+            float_columns[column.encoder].add(bits);
+        } else {
+            integer_columns[column.encoder].add(value.u);
+        }
+    }
+
+    if (++samples == block_samples) write_block();
+
+    // gives the output stream the chance to do its cyclic work
+    flush_output();
+}
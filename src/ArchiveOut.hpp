@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "MbOut.hpp"
+#include "archive_codec.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Archive file layout (native byte order):
+ *
+ * content
+ * -----------------------------------------------------------------------------------------------------
+ * archive_header_t
+ * archive_signal_t[signal_count]
+ * blocks: archive_block_header_t, uint32_t column_size[signal_count + 1], columns (time stamps first)
+ * archive_index_entry_t[block_count]  (written when the archive is closed)
+ * archive_trailer_t
+ *
+ * Each block contains block_samples samples (the last block may contain less) of all signals. The columns are
+ * encoded independently (see archive_codec.hpp). Blocks can be found via the block index or, if the archive was not
+ * closed properly, by following the block sizes.
+ */
+
+static constexpr char     ARCHIVE_MAGIC[8]       = {'M', 'B', 'S', 'H', 'M', 'A', 'R', 'C'};
+static constexpr char     ARCHIVE_INDEX_MAGIC[8] = {'M', 'B', 'A', 'R', 'C', 'I', 'D', 'X'};
+static constexpr uint32_t ARCHIVE_BLOCK_MAGIC    = 0x4B4C4241;  // "ABLK"
+static constexpr uint32_t ARCHIVE_VERSION        = 2;  // 2: signal flags
+
+/** the signal is scaled: the column contains float64 values in engineering units */
+static constexpr uint8_t ARCHIVE_SIGNAL_SCALED = 0x01;
+
+struct archive_header_t {
+    char     magic[8];       /**< ARCHIVE_MAGIC */
+    uint32_t version;        /**< ARCHIVE_VERSION */
+    uint32_t signal_count;   /**< number of signals */
+    uint32_t block_samples;  /**< samples per block */
+    uint32_t reserved[3];    /**< 0 */
+};
+
+struct archive_signal_t {
+    uint8_t  register_type;  /**< 0: do, 1: di, 2: ao, 3: ai */
+    uint8_t  data_type;      /**< data_type_t */
+    uint8_t  float_format;   /**< float_format_t */
+    uint8_t  flags;          /**< ARCHIVE_SIGNAL_* (version >= 2) */
+    uint8_t  reserved[4];    /**< 0 */
+    uint64_t index;          /**< index of the first register (coil) */
+};
+
+struct archive_block_header_t {
+    uint32_t magic;     /**< ARCHIVE_BLOCK_MAGIC */
+    uint32_t samples;   /**< number of samples */
+    uint64_t size;      /**< size of the block (including this header) */
+    int64_t  first_us;  /**< time stamp of the first sample (unix time in us) */
+    int64_t  last_us;   /**< time stamp of the last sample (unix time in us) */
+};
+
+struct archive_index_entry_t {
+    int64_t  first_us;  /**< time stamp of the first sample of the block */
+    int64_t  last_us;   /**< time stamp of the last sample of the block */
+    uint64_t offset;    /**< file offset of the block */
+    uint32_t samples;   /**< number of samples in the block */
+    uint32_t reserved;  /**< 0 */
+};
+
+struct archive_trailer_t {
+    uint64_t index_offset;  /**< file offset of the block index */
+    uint64_t block_count;   /**< number of blocks */
+    char     magic[8];      /**< ARCHIVE_INDEX_MAGIC */
+};
+
+static_assert(sizeof(archive_header_t) == 32);
+static_assert(sizeof(archive_signal_t) == 16);
+static_assert(sizeof(archive_block_header_t) == 32);
+static_assert(sizeof(archive_index_entry_t) == 32);
+static_assert(sizeof(archive_trailer_t) == 24);
+
+/**
+ * \brief write the decoded values to a compressed, column oriented archive
+ */
+class ArchiveOut : public MbOut {
+private:
+    /** encoder of a signal column */
+    struct column_t {
+        bool        is_float;
+        std::size_t encoder;  // index in float_columns or integer_columns
+    };
+
+    int                                  fd = -1;
+    uint64_t                             offset;
+    std::size_t                          block_samples;
+    std::size_t                          samples = 0;  // samples in the current block
+    int64_t                              first_us;
+    int64_t                              last_us;
+    archive::TimestampEncoder            timestamps;
+    std::vector<column_t>                columns;
+    std::vector<archive::FloatEncoder>   float_columns;
+    std::vector<archive::IntegerEncoder> integer_columns;
+    std::vector<archive_index_entry_t>   index;
+    std::vector<uint8_t>                 block;
+
+    void write(const void *data, std::size_t size);
+    void write_block();
+
+public:
+    /**
+     * \brief create archive
+     * @param path signal list
+     * @param out output stream (not used for the archive)
+     * @param file archive file (truncated if it exists)
+     * @param block_samples samples per block
+     * @param name_prefix shared memory name prefix
+     * @param float_format default float format (stored for the reader)
+     */
+    ArchiveOut(const std::string &path,
+               std::ostream      &out,
+               const std::string &file,
+               std::size_t        block_samples,
+               const std::string &name_prefix  = "modbus_",
+               float_format_t     float_format = float_format_t::scientific);
+
+    /** \brief write the last block and the block index */
+    ~ArchiveOut() override;
+
+    ArchiveOut(const ArchiveOut &)            = delete;
+    ArchiveOut &operator=(const ArchiveOut &) = delete;
+
+    void cycle() override;
+};
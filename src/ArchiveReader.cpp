@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "ArchiveReader.hpp"
+
+#include "format.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+ArchiveReader::ArchiveReader(const std::string &file) {
+    fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "failed to open '" + file + '\'');
+
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat)) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "failed to stat '" + file + '\'');
+    }
+    map_size = static_cast<std::size_t>(file_stat.st_size);
+
+    if (map_size < sizeof(archive_header_t)) {
+        close(fd);
+        throw std::runtime_error("'" + file + "' is not an archive");
+    }
+
+    auto *addr = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "failed to map '" + file + '\'');
+    }
+    map     = static_cast<const uint8_t *>(addr);
+    header  = reinterpret_cast<const archive_header_t *>(map);
+    signals = reinterpret_cast<const archive_signal_t *>(header + 1);
+
+    try {
+        if (memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic)) != 0)
+            throw std::runtime_error("'" + file + "' is not an archive");
+        // version 1: no signal flags (always 0)
+        if (header->version < 1 || header->version > ARCHIVE_VERSION)
+            throw std::runtime_error("unsupported archive version " + std::to_string(header->version));
+        if (sizeof(archive_header_t) + std::size_t {header->signal_count} * sizeof(archive_signal_t) > map_size)
+            throw std::runtime_error("'" + file + "' is truncated");
+
+        check_signals();
+        find_blocks();
+    } catch (...) {
+        munmap(const_cast<uint8_t *>(map), map_size);
+        close(fd);
+        throw;
+    }
+}
+
+ArchiveReader::~ArchiveReader() {
+    munmap(const_cast<uint8_t *>(map), map_size);
+    close(fd);
+}
+
+void ArchiveReader::check_signals() const {
+    for (std::size_t i = 0; i < header->signal_count; ++i) {
+        const auto &signal = signals[i];
+        if (signal.register_type > static_cast<uint8_t>(register_type_t::AI) ||
+            signal.data_type > static_cast<uint8_t>(data_type_t::f64br) ||
+            signal.float_format > static_cast<uint8_t>(float_format_t::shortest) ||
+            (signal.flags & ~ARCHIVE_SIGNAL_SCALED))
+            throw std::runtime_error("invalid signal descriptor in archive");
+
+        const bool is_coil = signal.register_type <= static_cast<uint8_t>(register_type_t::DI);
+        if (is_coil != (signal.data_type == static_cast<uint8_t>(data_type_t::bit)) ||
+            (is_coil && (signal.flags & ARCHIVE_SIGNAL_SCALED)))
+            throw std::runtime_error("invalid signal descriptor in archive");
+    }
+}
+
+void ArchiveReader::find_blocks() {
+    const std::size_t data_offset =
+            sizeof(archive_header_t) + std::size_t {header->signal_count} * sizeof(archive_signal_t);
+
+    // block index (if the archive was closed properly)
+    if (map_size >= data_offset + sizeof(archive_trailer_t)) {
+        archive_trailer_t trailer {};
+        memcpy(&trailer, map + map_size - sizeof(trailer), sizeof(trailer));
+        if (memcmp(trailer.magic, ARCHIVE_INDEX_MAGIC, sizeof(trailer.magic)) == 0 &&
+            trailer.index_offset >= data_offset &&
+            trailer.index_offset + trailer.block_count * sizeof(archive_index_entry_t) ==
+                    map_size - sizeof(archive_trailer_t)) {
+            index.resize(trailer.block_count);
+            memcpy(index.data(), map + trailer.index_offset, index.size() * sizeof(archive_index_entry_t));
+            has_index = true;
+            return;
+        }
+    }
+
+    // scan the blocks (the last block may be incomplete)
+    std::size_t offset = data_offset;
+    while (offset + sizeof(archive_block_header_t) <= map_size) {
+        archive_block_header_t block {};
+        memcpy(&block, map + offset, sizeof(block));
+        if (block.magic != ARCHIVE_BLOCK_MAGIC || block.size < sizeof(block) || block.size > map_size - offset) break;
+        index.push_back({block.first_us, block.last_us, offset, block.samples, 0});
+        offset += block.size;
+    }
+}
+
+uint64_t ArchiveReader::print(std::ostream &out, int64_t from_us) const {
+    // first block that contains samples >= from_us
+    const auto first = std::partition_point(
+            index.begin(), index.end(), [from_us](const archive_index_entry_t &entry) {
+                return entry.last_us < from_us;
+            });
+
+    uint64_t samples = 0;
+    for (auto entry = first; entry != index.end(); ++entry)
+        samples += print_block(out, *entry, from_us);
+    return samples;
+}
+
+/** line prefix of a signal: <reg>:<index>:[<type>:] */
+static std::string signal_prefix(const archive_signal_t &signal) {
+    static constexpr const char *REGISTER_NAMES[] = {"do:", "di:", "ao:", "ai:"};
+
+    char buffer[MAX_VALUE_CHARS];
+    auto end = format::dec(buffer, uint64_t {signal.index});
+
+    std::string prefix = REGISTER_NAMES[signal.register_type];
+    prefix.append(buffer, end);
+    prefix += ':';
+    if (signal.data_type != static_cast<uint8_t>(data_type_t::bit)) {
+        prefix += data_type_label(static_cast<data_type_t>(signal.data_type));
+        prefix += ':';
+    }
+    return prefix;
+}
+
+uint64_t ArchiveReader::print_block(std::ostream &out, const archive_index_entry_t &entry, int64_t from_us) const {
+    const std::size_t column_count = std::size_t {header->signal_count} + 1;
+
+    archive_block_header_t block {};
+    if (entry.offset + sizeof(block) > map_size) throw std::runtime_error("archive block out of range");
+    memcpy(&block, map + entry.offset, sizeof(block));
+    if (block.magic != ARCHIVE_BLOCK_MAGIC || block.size > map_size - entry.offset ||
+        block.size < sizeof(block) + column_count * sizeof(uint32_t))
+        throw std::runtime_error("invalid archive block at offset " + std::to_string(entry.offset));
+
+    const auto *base  = map + entry.offset;
+    const auto *sizes = base + sizeof(block);
+    const auto *data  = sizes + column_count * sizeof(uint32_t);
+    const auto *end   = base + block.size;
+
+    auto column = [&](std::size_t i, std::size_t &size) {
+        uint32_t column_size;
+        memcpy(&column_size, sizes + i * sizeof(column_size), sizeof(column_size));
+        if (column_size > static_cast<std::size_t>(end - data)) throw std::runtime_error("archive column out of range");
+        const auto *ret = data;
+        data += column_size;
+        size = column_size;
+        return ret;
+    };
+
+    std::size_t size;
+    const auto *timestamp_column = column(0, size);
+    archive::TimestampDecoder timestamps(timestamp_column, size);
+
+    struct decoder_t {
+        std::unique_ptr<archive::FloatDecoder>   float_decoder;
+        std::unique_ptr<archive::IntegerDecoder> integer_decoder;
+        data_type_t                              data_type;
+        bool                                     scaled;
+        value_kind_t                             kind;
+        float_format_t                           float_format;
+        std::string                              prefix;
+    };
+
+    std::vector<decoder_t> decoders(header->signal_count);
+    for (std::size_t i = 0; i < header->signal_count; ++i) {
+        const auto &signal  = signals[i];
+        auto       &decoder = decoders[i];
+        const auto *ptr     = column(i + 1, size);
+        decoder.data_type    = static_cast<data_type_t>(signal.data_type);
+        decoder.scaled       = (signal.flags & ARCHIVE_SIGNAL_SCALED) != 0;
+        decoder.kind         = decoder.scaled ? value_kind_t::float64 : data_type_value_kind(decoder.data_type);
+        decoder.float_format = static_cast<float_format_t>(signal.float_format);
+        decoder.prefix       = signal_prefix(signal);
+        switch (decoder.kind) {
+            case value_kind_t::float32:
+                decoder.float_decoder = std::make_unique<archive::FloatDecoder>(ptr, size, 32);
+                break;
+            case value_kind_t::float64:
+                decoder.float_decoder = std::make_unique<archive::FloatDecoder>(ptr, size, 64);
+                break;
+            case value_kind_t::unsigned_int:
+            case value_kind_t::signed_int:
+            case value_kind_t::hex:
+                decoder.integer_decoder = std::make_unique<archive::IntegerDecoder>(ptr, size);
+                break;
+            default: throw std::logic_error("unknown value kind");
+        }
+    }
+
+    std::string text;
+    uint64_t    samples = 0;
+    for (std::size_t s = 0; s < block.samples; ++s) {
+        const bool output = timestamps.next() >= from_us;
+
+        for (auto &decoder : decoders) {
+            value_t value {};
+            if (decoder.kind == value_kind_t::float32) {
+                const auto bits32 = static_cast<uint32_t>(decoder.float_decoder->next());
+                memcpy(&value.f32, &bits32, sizeof(bits32));
+            } else if (decoder.kind == value_kind_t::float64) {
+                const auto bits = decoder.float_decoder->next();
+                memcpy(&value.f64, &bits, sizeof(bits));
+            } else {
+                value.u = decoder.integer_decoder->next();
+            }
+
+            if (!output) continue;
+
+            char buffer[MAX_VALUE_CHARS];
+            text += decoder.prefix;
+            text.append(buffer,
+                        decoder.scaled ? format::flt(buffer, value.f64, decoder.float_format)
+                                       : format::value(buffer, decoder.data_type, value, decoder.float_format));
+            text += '\n';
+        }
+
+        if (output) ++samples;
+    }
+
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    return samples;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "ArchiveOut.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * \brief decode an archive (see ArchiveOut) to the text format of the cyclic output
+ */
+class ArchiveReader {
+private:
+    int                                fd  = -1;
+    const uint8_t                     *map = nullptr;
+    std::size_t                        map_size;
+    const archive_header_t            *header;
+    const archive_signal_t            *signals;
+    std::vector<archive_index_entry_t> index;
+    bool                               has_index = false;
+
+    void find_blocks();
+    void check_signals() const;
+
+    /** \brief decode one block, output samples with a time stamp >= from_us */
+    uint64_t print_block(std::ostream &out, const archive_index_entry_t &entry, int64_t from_us) const;
+
+public:
+    /**
+     * \brief open archive
+     * @param file archive file
+     */
+    explicit ArchiveReader(const std::string &file);
+
+    ~ArchiveReader();
+
+    ArchiveReader(const ArchiveReader &)            = delete;
+    ArchiveReader &operator=(const ArchiveReader &) = delete;
+
+    /** \brief number of blocks */
+    [[nodiscard]] std::size_t blocks() const { return index.size(); }
+
+    /** \brief false if the archive was not closed properly (blocks were found by scanning the file) */
+    [[nodiscard]] bool indexed() const { return has_index; }
+
+    /**
+     * \brief write the samples in the text format of the cyclic output
+     * @param out output stream
+     * @param from_us skip samples before this time (unix time in us). The block index is used to find the first block.
+     * @return number of samples written
+     */
+    uint64_t print(std::ostream &out, int64_t from_us = std::numeric_limits<int64_t>::min()) const;
+};
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "BatchDecoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#    include <immintrin.h>
+#endif
+
+void BatchDecoder::add(data_type_t data_type, const uint8_t *addr, std::size_t index) {
+    auto group = std::find_if(groups.begin(), groups.end(), [data_type](const group_t &g) {
+        return g.data_type == data_type;
+    });
+    if (group == groups.end()) {
+        groups.push_back({data_type, {}, {}});
+        group = groups.end() - 1;
+    }
+
+    group->addrs.push_back(addr);
+    group->indices.push_back(index);
+}
+
+#if defined(__SSSE3__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+/** byte order and register order of a data type as byte permutation: result byte k = source byte pattern[k] */
+struct shuffle_t {
+    std::size_t   bytes;        // size of the value
+    bool          sign_extend;  // signed integer (else: zero extension)
+    const int8_t *pattern;
+};
+
+/**
+ * \brief get the byte permutation of a data type
+ * @return false if the data type is not decoded by decode_simd() (bits and 8 bit types)
+ */
+static bool get_shuffle(data_type_t data_type, shuffle_t &shuffle) {
+    static constexpr int8_t P16L[]  = {0, 1};
+    static constexpr int8_t P16B[]  = {1, 0};
+    static constexpr int8_t P32L[]  = {0, 1, 2, 3};
+    static constexpr int8_t P32LR[] = {2, 3, 0, 1};
+    static constexpr int8_t P32B[]  = {3, 2, 1, 0};
+    static constexpr int8_t P32BR[] = {1, 0, 3, 2};
+    static constexpr int8_t P64L[]  = {0, 1, 2, 3, 4, 5, 6, 7};
+    static constexpr int8_t P64LR[] = {6, 7, 4, 5, 2, 3, 0, 1};
+    static constexpr int8_t P64B[]  = {7, 6, 5, 4, 3, 2, 1, 0};
+    static constexpr int8_t P64BR[] = {1, 0, 3, 2, 5, 4, 7, 6};
+
+    switch (data_type) {
+        case data_type_t::u16l:
+        case data_type_t::x16l: shuffle = {2, false, P16L}; return true;
+        case data_type_t::u16b:
+        case data_type_t::x16b: shuffle = {2, false, P16B}; return true;
+        case data_type_t::i16l: shuffle = {2, true, P16L}; return true;
+        case data_type_t::i16b: shuffle = {2, true, P16B}; return true;
+        case data_type_t::u32l:
+        case data_type_t::x32l:
+        case data_type_t::f32l: shuffle = {4, false, P32L}; return true;
+        case data_type_t::u32lr:
+        case data_type_t::x32lr:
+        case data_type_t::f32lr: shuffle = {4, false, P32LR}; return true;
+        case data_type_t::u32b:
+        case data_type_t::x32b:
+        case data_type_t::f32b: shuffle = {4, false, P32B}; return true;
+        case data_type_t::u32br:
+        case data_type_t::x32br:
+        case data_type_t::f32br: shuffle = {4, false, P32BR}; return true;
+        case data_type_t::i32l: shuffle = {4, true, P32L}; return true;
+        case data_type_t::i32lr: shuffle = {4, true, P32LR}; return true;
+        case data_type_t::i32b: shuffle = {4, true, P32B}; return true;
+        case data_type_t::i32br: shuffle = {4, true, P32BR}; return true;
+        case data_type_t::u64l:
+        case data_type_t::x64l:
+        case data_type_t::i64l:
+        case data_type_t::f64l: shuffle = {8, false, P64L}; return true;
+        case data_type_t::u64lr:
+        case data_type_t::x64lr:
+        case data_type_t::i64lr:
+        case data_type_t::f64lr: shuffle = {8, false, P64LR}; return true;
+        case data_type_t::u64b:
+        case data_type_t::x64b:
+        case data_type_t::i64b:
+        case data_type_t::f64b: shuffle = {8, false, P64B}; return true;
+        case data_type_t::u64br:
+        case data_type_t::x64br:
+        case data_type_t::i64br:
+        case data_type_t::f64br: shuffle = {8, false, P64BR}; return true;
+        default: return false;
+    }
+}
+
+template <typename T>
+static inline T load(const uint8_t *addr) {
+    T value;
+    memcpy(&value, addr, sizeof(value));
+    return value;
+}
+
+/** \brief store the two 64 bit lanes of v */
+static inline void store2(value_t *values, std::size_t index0, std::size_t index1, __m128i v) {
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(values + index0), v);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(values + index1), _mm_unpackhi_epi64(v, v));
+}
+
+/**
+ * \brief decode the signals of one data type with byte shuffles
+ * @return number of decoded signals (the remaining signals do not fill a vector)
+ */
+static std::size_t decode_simd(data_type_t           data_type,
+                               const uint8_t *const *addrs,
+                               const std::size_t    *indices,
+                               std::size_t           n,
+                               value_t              *values) {
+    shuffle_t shuffle {};
+    if (!get_shuffle(data_type, shuffle)) return 0;
+
+    // the permutation of one value repeated for each value in the vector
+    alignas(16) int8_t mask_bytes[16];
+    for (std::size_t k = 0; k < 16; ++k)
+        mask_bytes[k] = static_cast<int8_t>(k / shuffle.bytes * shuffle.bytes +
+                                            static_cast<std::size_t>(shuffle.pattern[k % shuffle.bytes]));
+    const auto mask = _mm_load_si128(reinterpret_cast<const __m128i *>(mask_bytes));
+    const auto zero = _mm_setzero_si128();
+
+    std::size_t i = 0;
+    switch (shuffle.bytes) {
+        case 2:
+            for (; i + 8 <= n; i += 8) {
+                const auto *a = addrs + i;
+                const auto  v = _mm_shuffle_epi8(_mm_setr_epi16(load<int16_t>(a[0]),
+                                                               load<int16_t>(a[1]),
+                                                               load<int16_t>(a[2]),
+                                                               load<int16_t>(a[3]),
+                                                               load<int16_t>(a[4]),
+                                                               load<int16_t>(a[5]),
+                                                               load<int16_t>(a[6]),
+                                                               load<int16_t>(a[7])),
+                                            mask);
+
+                // extend to 32 bit, then to 64 bit
+                const auto ext16 = shuffle.sign_extend ? _mm_srai_epi16(v, 15) : zero;
+                const auto lo32  = _mm_unpacklo_epi16(v, ext16);
+                const auto hi32  = _mm_unpackhi_epi16(v, ext16);
+                const auto ext_l = shuffle.sign_extend ? _mm_srai_epi32(lo32, 31) : zero;
+                const auto ext_h = shuffle.sign_extend ? _mm_srai_epi32(hi32, 31) : zero;
+
+                const auto *idx = indices + i;
+                store2(values, idx[0], idx[1], _mm_unpacklo_epi32(lo32, ext_l));
+                store2(values, idx[2], idx[3], _mm_unpackhi_epi32(lo32, ext_l));
+                store2(values, idx[4], idx[5], _mm_unpacklo_epi32(hi32, ext_h));
+                store2(values, idx[6], idx[7], _mm_unpackhi_epi32(hi32, ext_h));
+            }
+            break;
+        case 4:
+            for (; i + 4 <= n; i += 4) {
+                const auto *a = addrs + i;
+                const auto  v = _mm_shuffle_epi8(_mm_setr_epi32(load<int32_t>(a[0]),
+                                                               load<int32_t>(a[1]),
+                                                               load<int32_t>(a[2]),
+                                                               load<int32_t>(a[3])),
+                                            mask);
+
+                // float: the upper half of the value is 0 (as in decode_value())
+                const auto  ext = shuffle.sign_extend ? _mm_srai_epi32(v, 31) : zero;
+                const auto *idx = indices + i;
+                store2(values, idx[0], idx[1], _mm_unpacklo_epi32(v, ext));
+                store2(values, idx[2], idx[3], _mm_unpackhi_epi32(v, ext));
+            }
+            break;
+        case 8:
+            for (; i + 2 <= n; i += 2) {
+                const auto *a = addrs + i;
+                const auto  v = _mm_shuffle_epi8(_mm_set_epi64x(load<int64_t>(a[1]), load<int64_t>(a[0])), mask);
+                store2(values, indices[i], indices[i + 1], v);
+            }
+            break;
+        default: break;
+    }
+    return i;
+}
+
+#endif
+
+void BatchDecoder::decode(value_t *values) const {
+    for (const auto &group : groups) {
+        const auto  n       = group.addrs.size();
+        const auto *addrs   = group.addrs.data();
+        const auto *indices = group.indices.data();
+
+        std::size_t i = 0;
+#if defined(__SSSE3__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        i = decode_simd(group.data_type, addrs, indices, n, values);
+#endif
+
+        // remaining signals (all signals without SSSE3): one data type, the branches of decode_value() are predictable
+        for (; i < n; ++i)
+            values[indices[i]] = decode_value(group.data_type, addrs[i]);
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "data_types.hpp"
+#include "decode.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief decode many signals grouped by data type
+ *
+ * The signals are stored as structure of arrays per data type (source address and index in the value array).
+ * Each data type is decoded in one homogeneous loop. With SSSE3, the byte order and register order of 16, 32 and
+ * 64 bit values are applied to a vector of gathered values with one byte shuffle (pshufb); the result is the same as
+ * decode_value().
+ */
+class BatchDecoder {
+public:
+    /**
+     * \brief add a signal
+     * @param data_type data type of the signal
+     * @param addr address of the first register (or coil) of the signal
+     * @param index index of the decoded value in the value array
+     */
+    void add(data_type_t data_type, const uint8_t *addr, std::size_t index);
+
+    /**
+     * \brief decode all signals
+     * @param values value array (must contain all indices)
+     */
+    void decode(value_t *values) const;
+
+private:
+    struct group_t {
+        data_type_t                  data_type;
+        std::vector<const uint8_t *> addrs;
+        std::vector<std::size_t>     indices;
+    };
+
+    std::vector<group_t> groups;
+};
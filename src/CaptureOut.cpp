@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "CaptureOut.hpp"
+
+#include "split_string.hpp"
+
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+
+/** size of the time stamp at the beginning of each record */
+static constexpr std::size_t TIMESTAMP_SIZE = sizeof(int64_t);
+
+/** the output thread writes to the output stream if this number of bytes is buffered */
+static constexpr std::size_t DUMP_WRITE_SIZE = 64 * 1024;
+
+CaptureOut::CaptureOut(const std::string &path,
+                       std::ostream      &out,
+                       std::size_t        pre_cycles,
+                       std::size_t        post_cycles,
+                       const std::string &name_prefix,
+                       float_format_t     float_format)
+    : MbOut(path, out, name_prefix, float_format), pre_cycles(pre_cycles), post_cycles(post_cycles),
+      capacity(2 * (pre_cycles + post_cycles + 1)) {
+    std::size_t size = 0;
+    entries.reserve(signals.size());
+    for (const auto &signal : signals) {
+        const auto signal_size = data_type_registers(signal.data_type) * register_bytes(signal.register_type);
+        entries.push_back({signal_addr(signal), size, signal_size});
+        size += signal_size;
+    }
+
+    // keep time stamps aligned
+    record_size = (TIMESTAMP_SIZE + size + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    ring        = std::make_unique<uint64_t[]>(capacity * record_size / sizeof(uint64_t));
+    dump_buffer.reserve(DUMP_WRITE_SIZE + MAX_LINE_CHARS + 24);
+
+    dump_thread = std::thread(&CaptureOut::dump_loop, this);
+}
+
+CaptureOut::~CaptureOut() {
+    {
+        std::lock_guard<std::mutex> lock(dump_mutex);
+        stop = true;
+    }
+    dump_cv.notify_one();
+    dump_thread.join();
+}
+
+void CaptureOut::add_edge_trigger(const std::string &spec) {
+    const auto split_spec = split_string(spec, ':');
+    if (split_spec.size() < 2 || split_spec.size() > 3) throw std::runtime_error("invalid trigger '" + spec + '\'');
+
+    const auto reg_type = str_to_register_type(split_spec[0]);
+    if (reg_type != register_type_t::DO && reg_type != register_type_t::DI)
+        throw std::runtime_error("edge trigger requires a coil (do or di): '" + spec + '\'');
+
+    const auto        &index_str = split_spec[1];
+    unsigned long long index;
+    std::size_t        idx  = 0;
+    bool               fail = false;
+    try {
+        index = std::stoull(index_str, &idx, 0);
+    } catch (const std::exception &) { fail = true; }
+    if (fail || idx != index_str.size()) throw std::runtime_error("invalid trigger index '" + index_str + '\'');
+    if (index >= shm(reg_type).get_size()) throw std::runtime_error("trigger index out of range: '" + spec + '\'');
+
+    edge_t edge = edge_t::rising;
+    if (split_spec.size() == 3) {
+        if (split_spec[2] == "rising") edge = edge_t::rising;
+        else if (split_spec[2] == "falling")
+            edge = edge_t::falling;
+        else if (split_spec[2] == "both")
+            edge = edge_t::both;
+        else
+            throw std::runtime_error("unknown edge '" + split_spec[2] + '\'');
+    }
+
+    const auto *coil = shm(reg_type).get_addr<const uint8_t *>() + index;
+    edge_triggers.push_back({coil, edge, *coil != 0, spec});
+}
+
+void CaptureOut::add_condition_trigger(std::unique_ptr<Expression> condition) {
+    const bool state = condition->evaluate();
+    condition_triggers.push_back({std::move(condition), state});
+}
+
+void CaptureOut::cycle() {
+    if (state == state_t::dumping && !dumping.load(std::memory_order_acquire)) {
+        state = state_t::idle;
+        if (discarded) {
+            std::cerr << "WARNING: capture: " << discarded << " samples discarded while writing the capture"
+                      << std::endl;
+            discarded = 0;
+        }
+    }
+
+    for (auto &edge_trigger : edge_triggers) {
+        const bool coil_state = *edge_trigger.coil != 0;
+        const bool changed    = coil_state != edge_trigger.state;
+        edge_trigger.state    = coil_state;
+
+        if (changed && !pending_trigger &&
+            (edge_trigger.edge == edge_t::both || (edge_trigger.edge == edge_t::rising) == coil_state))
+            pending_trigger = edge_trigger.source.c_str();
+    }
+
+    for (auto &condition_trigger : condition_triggers) {
+        const bool state        = condition_trigger.condition->evaluate();
+        const bool became_true  = state && !condition_trigger.state;
+        condition_trigger.state = state;
+
+        if (became_true && !pending_trigger) pending_trigger = condition_trigger.condition->str().c_str();
+    }
+
+    // do not overwrite records that the output thread still needs
+    if (state == state_t::dumping && seq >= capacity && seq - capacity >= dump_pos.load(std::memory_order_acquire)) {
+        ++discarded;
+        pending_trigger = nullptr;
+        return;
+    }
+
+    auto    *rec = record(seq);
+    timespec ts {};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    const int64_t time_ns = ts.tv_sec * 1000000000 + ts.tv_nsec;
+    memcpy(rec, &time_ns, TIMESTAMP_SIZE);
+    for (const auto &entry : entries)
+        memcpy(rec + TIMESTAMP_SIZE + entry.offset, entry.shm, entry.size);
+
+    // triggers during a capture are ignored
+    if (state == state_t::idle && pending_trigger) {
+        state       = state_t::post;
+        trigger_seq = seq;
+        source      = pending_trigger;
+    }
+    pending_trigger = nullptr;
+
+    if (state == state_t::post && seq - trigger_seq == post_cycles) {
+        capture_first = trigger_seq >= pre_cycles ? trigger_seq - pre_cycles : 0;
+        capture_end   = seq + 1;
+        start_dump();
+    }
+
+    ++seq;
+}
+
+void CaptureOut::start_dump() {
+    state = state_t::dumping;
+    dump_pos.store(capture_first, std::memory_order_release);
+    dumping.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(dump_mutex);
+        dump_request = true;
+    }
+    dump_cv.notify_one();
+}
+
+void CaptureOut::dump_loop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(dump_mutex);
+            dump_cv.wait(lock, [this] { return dump_request || stop; });
+            if (!dump_request) return;
+            dump_request = false;
+        }
+
+        try {
+            dump();
+        } catch (const std::exception &e) { std::cerr << "ERROR: capture: " << e.what() << std::endl; }
+        dumping.store(false, std::memory_order_release);
+    }
+}
+
+void CaptureOut::dump() {
+    auto time_us = [this](uint64_t record_seq) {
+        int64_t time_ns;
+        memcpy(&time_ns, record(record_seq), TIMESTAMP_SIZE);
+        return static_cast<uint64_t>(time_ns / 1000);
+    };
+
+    char  line[MAX_LINE_CHARS + 24];
+    char *p = line;
+    dump_buffer.clear();
+    dump_buffer.append("capture:begin:");
+    dump_buffer.append(source);
+    dump_buffer.push_back(':');
+    p    = format::dec(p, time_us(trigger_seq));
+    *p++ = '\n';
+    dump_buffer.append(line, p);
+
+    for (auto r = capture_first; r < capture_end; ++r) {
+        const auto *rec = record(r);
+
+        char *const prefix_end = format::dec(line, time_us(r));
+        *prefix_end            = ':';
+        for (std::size_t i = 0; i < signals.size(); ++i) {
+            const auto &signal = signals[i];
+            const auto  value  = decode_signal(signal, rec + TIMESTAMP_SIZE + entries[i].offset);
+            p                  = format_signal(prefix_end + 1, signal, value);
+            dump_buffer.append(line, p);
+
+            if (dump_buffer.size() >= DUMP_WRITE_SIZE) {
+                out.write(dump_buffer.data(), static_cast<std::streamsize>(dump_buffer.size()));
+                dump_buffer.clear();
+            }
+        }
+
+        dump_pos.store(r + 1, std::memory_order_release);
+    }
+
+    dump_buffer.append("capture:end\n");
+    out.write(dump_buffer.data(), static_cast<std::streamsize>(dump_buffer.size()));
+    dump_buffer.clear();
+    out.flush();
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "Expression.hpp"
+#include "MbOut.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief capture the history of the signals around a trigger (oscilloscope mode)
+ *
+ * Each cycle the raw register values of all signals are stored with a time stamp in a preallocated ring. Nothing is
+ * written in steady state. If a trigger occurs, recording continues for the configured number of post-trigger cycles.
+ * Afterwards the pre-trigger and post-trigger records are written to the output stream by a separate thread, so the
+ * sampling is not delayed by the output.
+ *
+ * The ring holds twice the number of records of one capture. If the output thread can not keep up, records are not
+ * overwritten before they are written; new samples are discarded instead (and counted).
+ *
+ * Output of a capture:
+ * capture:begin:<trigger source>:<trigger time (unix time in us)>
+ * <time (unix time in us)>:<signal line> (for each record and signal)
+ * capture:end
+ */
+class CaptureOut : public MbOut {
+public:
+    enum class edge_t {
+        rising,  /**< 0 -> 1 */
+        falling, /**< 1 -> 0 */
+        both,    /**< any change */
+    };
+
+    /**
+     * \brief create capture output
+     * @param path signal list
+     * @param out output stream (only used by the output thread)
+     * @param pre_cycles number of records before the trigger
+     * @param post_cycles number of records after the trigger
+     * @param name_prefix shared memory name prefix
+     * @param float_format default float output format
+     */
+    CaptureOut(const std::string &path,
+               std::ostream      &out,
+               std::size_t        pre_cycles,
+               std::size_t        post_cycles,
+               const std::string &name_prefix  = "modbus_",
+               float_format_t     float_format = float_format_t::scientific);
+
+    ~CaptureOut() override;
+
+    CaptureOut(const CaptureOut &)            = delete;
+    CaptureOut &operator=(const CaptureOut &) = delete;
+
+    /**
+     * \brief trigger on an edge of a coil (the coil does not need to be part of the signal list)
+     * @param spec <do|di>:<index>[:rising|falling|both] (default: rising)
+     */
+    void add_edge_trigger(const std::string &spec);
+
+    /**
+     * \brief trigger if a condition becomes true
+     * @param condition condition that is evaluated each cycle
+     */
+    void add_condition_trigger(std::unique_ptr<Expression> condition);
+
+    /**
+     * \brief trigger a capture with the next cycle
+     *
+     * Ignored while a capture is in progress.
+     *
+     * @param source name of the trigger source (static string)
+     */
+    void trigger(const char *source) { pending_trigger = source; }
+
+    void cycle() override;
+
+private:
+    struct record_entry_t {
+        const uint8_t *shm;     // address of the signal in the shared memory
+        std::size_t    offset;  // offset of the signal in a record
+        std::size_t    size;    // size of the signal in bytes
+    };
+
+    struct edge_trigger_t {
+        const uint8_t *coil;
+        edge_t         edge;
+        bool           state;
+        std::string    source;
+    };
+
+    enum class state_t {
+        idle,    /**< waiting for a trigger */
+        post,    /**< recording post-trigger records */
+        dumping, /**< output thread writes the capture */
+    };
+
+    std::size_t                 pre_cycles;
+    std::size_t                 post_cycles;
+    std::size_t                 capacity;     // number of records in the ring
+    std::size_t                 record_size;  // bytes per record (including time stamp)
+    std::unique_ptr<uint64_t[]> ring;
+    std::vector<record_entry_t> entries;  // one entry per signal
+
+    struct condition_trigger_t {
+        std::unique_ptr<Expression> condition;
+        bool                        state;
+    };
+
+    std::vector<edge_trigger_t>      edge_triggers;
+    std::vector<condition_trigger_t> condition_triggers;
+
+    uint64_t    seq             = 0;  // sequence number of the next record
+    uint64_t    discarded       = 0;  // records that were discarded since the last report
+    state_t     state           = state_t::idle;
+    const char *pending_trigger = nullptr;
+
+    // capture that is handed to the output thread
+    uint64_t    capture_first = 0;
+    uint64_t    capture_end   = 0;  // first record after the capture
+    uint64_t    trigger_seq   = 0;
+    const char *source        = nullptr;
+
+    std::atomic<uint64_t>   dump_pos {0};  // next record that is read by the output thread
+    std::atomic<bool>       dumping {false};
+    std::mutex              dump_mutex;
+    std::condition_variable dump_cv;
+    bool                    dump_request = false;
+    bool                    stop         = false;
+    std::string             dump_buffer;
+    std::thread             dump_thread;
+
+    [[nodiscard]] uint8_t *record(uint64_t record_seq) const {
+        return reinterpret_cast<uint8_t *>(ring.get()) + (record_seq % capacity) * record_size;
+    }
+
+    void start_dump();
+    void dump_loop();
+    void dump();
+};
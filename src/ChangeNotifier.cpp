@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "ChangeNotifier.hpp"
+
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static long futex(std::atomic<uint32_t> *addr, int op, uint32_t val, const timespec *timeout) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), op, val, timeout, nullptr, 0);
+}
+
+ChangeNotifier::ChangeNotifier(const std::string &name) : shm(name) {
+    if (shm.get_size() < sizeof(notify_t)) throw std::runtime_error("notification segment '" + name + "' too small");
+    word = shm.get_addr<notify_t *>();
+    last = word->generation.load(std::memory_order_acquire);
+}
+
+bool ChangeNotifier::wait(std::chrono::milliseconds timeout) {
+    auto generation = word->generation.load(std::memory_order_acquire);
+    if (generation == last) {
+        timespec ts {};
+        ts.tv_sec  = timeout.count() / 1000;
+        ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+
+        // register as waiter before the final check, so the writer can not miss us
+        word->waiters.fetch_add(1);
+        if (word->generation.load() == last) futex(&word->generation, FUTEX_WAIT, last, &ts);
+        word->waiters.fetch_sub(1);
+
+        generation = word->generation.load(std::memory_order_acquire);
+    }
+
+    const bool changed = generation != last;
+    last               = generation;
+    return changed;
+}
+
+void ChangeNotifier::notify() {
+    word->generation.fetch_add(1);
+    if (word->waiters.load()) futex(&word->generation, FUTEX_WAKE, INT_MAX, nullptr);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "cxxshm.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * \brief wait for change notifications of the process that writes the modbus shared memories
+ *
+ * The notification segment (<name prefix>notify) contains a generation counter that is used as futex word:
+ *
+ * offset | type     | content
+ * -------+----------+---------------------------------------------------------
+ * 0      | uint32_t | generation: incremented by the writer after each update
+ * 4      | uint32_t | waiters: number of processes that are waiting
+ *
+ * Writer protocol (after the registers were updated):
+ *  1. increment generation (sequentially consistent)
+ *  2. if waiters is not 0: futex(&generation, FUTEX_WAKE, INT_MAX) (shared futex, not FUTEX_PRIVATE_FLAG)
+ */
+class ChangeNotifier final {
+public:
+    struct notify_t {
+        std::atomic<uint32_t> generation;
+        std::atomic<uint32_t> waiters;
+    };
+
+    static_assert(sizeof(notify_t) == 8);
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+    /**
+     * \brief open notification segment
+     * @param name name of the shared memory
+     * @exception std::system_error segment does not exist
+     */
+    explicit ChangeNotifier(const std::string &name);
+
+    /**
+     * \brief wait until the generation changes
+     * @param timeout maximum wait time
+     * @return true if the generation has changed, false on timeout or signal
+     */
+    bool wait(std::chrono::milliseconds timeout);
+
+    /**
+     * \brief notify all waiting processes (writer side)
+     */
+    void notify();
+
+private:
+    cxxshm::SharedMemory shm;
+    notify_t            *word;
+    uint32_t             last;
+};
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "ChangeProfile.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+ChangeProfile::ChangeProfile(std::size_t signals, int64_t start_ns)
+    : counters(signals), start(start_ns), now(start_ns) {}
+
+/**
+ * \brief estimate the number of changes that happened between two polls and were not observed
+ * @param changes observed changes
+ * @param consecutive observed changes in the poll after the previous change (< changes)
+ */
+static double estimate_missed(uint64_t changes, uint64_t consecutive) {
+    if (consecutive == 0) return 0.0;
+    const double q    = static_cast<double>(consecutive) / static_cast<double>(changes);
+    const double rate = -std::log1p(-q);  // changes per poll
+    return static_cast<double>(changes) * (rate / q - 1.0);
+}
+
+void ChangeProfile::report(std::ostream &out, const std::vector<std::string> &names) const {
+    std::vector<std::size_t> changed;
+    for (std::size_t i = 0; i < counters.size(); ++i)
+        if (counters[i].changes) changed.push_back(i);
+    std::stable_sort(changed.begin(), changed.end(), [this](std::size_t a, std::size_t b) {
+        return counters[a].changes > counters[b].changes;
+    });
+
+    const double seconds   = static_cast<double>(now - start) / 1e9;
+    const auto   flags     = out.flags();
+    const auto   precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    out << "change profile: " << polls << " polls in " << seconds << " s, " << changed.size() << " of "
+        << counters.size() << " signals changed\n";
+    out << "signal changes changes/s min_interval_ms max_interval_ms consecutive est_missed\n";
+
+    for (const auto i : changed) {
+        const auto &counter = counters[i];
+        out << names[i] << ' ' << counter.changes << ' '
+            << (seconds > 0.0 ? static_cast<double>(counter.changes) / seconds : 0.0) << ' ';
+        if (counter.changes > 1) {
+            out << static_cast<double>(counter.min_interval) / 1e6 << ' '
+                << static_cast<double>(counter.max_interval) / 1e6 << ' ';
+        } else {
+            out << "- - ";
+        }
+        out << counter.consecutive << ' ' << std::llround(estimate_missed(counter.changes, counter.consecutive))
+            << '\n';
+    }
+    out.flush();
+
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * \brief change rate statistics of the signals of the event mode
+ *
+ * One counter per signal is kept: number of observed changes, min/max interval between two changes and the number
+ * of changes that were observed in the poll directly after the previous change. The counters are only updated if a
+ * change is detected; the time stamp is taken once per poll.
+ *
+ * Missed changes: if a signal changes in the poll after a change, more than one change might have happened between
+ * the polls. With changes as a poisson process, the fraction q of changes that are followed by a change in the next
+ * poll is P(at least one change per poll) = 1 - e^-r, so each observed change stands for r / q changes (r: changes
+ * per poll). The estimate assumes that a change never restores the previous value and is 0 for signals that never
+ * change in consecutive polls.
+ */
+class ChangeProfile {
+public:
+    /**
+     * \brief create profile
+     * @param signals number of signals
+     * @param start_ns time stamp of the initial state (CLOCK_MONOTONIC)
+     */
+    ChangeProfile(std::size_t signals, int64_t start_ns);
+
+    /**
+     * \brief start a poll
+     * @param now_ns time stamp of the poll (CLOCK_MONOTONIC)
+     */
+    void begin_poll(int64_t now_ns) noexcept {
+        ++polls;
+        now = now_ns;
+    }
+
+    /** \brief a change of a signal was observed in the current poll */
+    void change(std::size_t signal) noexcept {
+        auto &counter = counters[signal];
+        if (counter.changes) {
+            const auto interval = now - counter.last_change;
+            if (interval < counter.min_interval) counter.min_interval = interval;
+            if (interval > counter.max_interval) counter.max_interval = interval;
+            if (counter.last_poll + 1 == polls) ++counter.consecutive;
+        }
+        ++counter.changes;
+        counter.last_poll   = polls;
+        counter.last_change = now;
+    }
+
+    /**
+     * \brief write the statistics of all signals that changed, sorted by number of changes (descending)
+     * @param out output stream
+     * @param names signal names
+     */
+    void report(std::ostream &out, const std::vector<std::string> &names) const;
+
+private:
+    struct counter_t {
+        uint64_t changes      = 0;
+        uint64_t consecutive  = 0;  // changes in the poll after the previous change
+        uint64_t last_poll    = 0;
+        int64_t  last_change  = 0;  // ns
+        int64_t  min_interval = std::numeric_limits<int64_t>::max();
+        int64_t  max_interval = 0;
+    };
+
+    std::vector<counter_t> counters;
+
+    uint64_t polls = 0;
+    int64_t  start;
+    int64_t  now;
+};
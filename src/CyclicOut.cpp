@@ -5,10 +5,151 @@
 
 #include "CyclicOut.hpp"
 
+#include <algorithm>
+#include <ctime>
+#include <functional>
 #include <ostream>
+#include <stdexcept>
 
 void CyclicOut::cycle() {
-    for (const auto &signal : signals)
-        output_signal(signal);
-    out << std::flush;
+    begin_output();
+
+    if (scheduled) {
+        cycle_groups();
+        return;
+    }
+
+    if (threads > 1) {
+        cycle_parallel();
+        return;
+    }
+
+    decode_signals();
+    for (std::size_t i = 0; i < signals.size(); ++i)
+        output_signal(i);
+    flush_output();
+}
+
+void CyclicOut::set_parallel(std::size_t threads, std::size_t chunk_size, schedule_t schedule) {
+    if (threads == 0) throw std::invalid_argument("number of threads must not be 0");
+    if (chunk_size == 0) throw std::invalid_argument("chunk size must not be 0");
+#ifndef _OPENMP
+    if (threads > 1) throw std::runtime_error("parallel output requires OpenMP support");
+#endif
+
+    this->threads    = threads;
+    this->chunk_size = chunk_size;
+    this->schedule   = schedule;
+    chunks.clear();
+    chunks.resize((signals.size() + chunk_size - 1) / chunk_size);
+    for (std::size_t c = 0; c < chunks.size(); ++c) {
+        auto      &chunk = chunks[c];
+        const auto first = c * chunk_size;
+        const auto count = std::min(chunk_size, signals.size() - first);
+        for (auto i = first; i < first + count; ++i)
+            chunk.decoder.add(signals[i].data_type, signal_addr(signals[i]), i);
+        scaled_range(first, count, chunk.first_scaled, chunk.scaled_count);
+        chunk.buffer.reserve(chunk_size * MAX_LINE_CHARS);
+    }
+}
+
+void CyclicOut::format_chunk(std::size_t index) {
+    auto      &chunk = chunks[index];
+    const auto first = index * chunk_size;
+    const auto last  = std::min(first + chunk_size, signals.size());
+
+    // the chunks write disjoint ranges of values and of the scaling entries
+    chunk.decoder.decode(values.data());
+    scale_signals(chunk.first_scaled, chunk.scaled_count);
+
+    // each chunk has its own line protocol lines
+    InfluxFormat::line_t line;
+    chunk.buffer.clear();
+    for (auto i = first; i < last; ++i)
+        append_signal(chunk.buffer, line, i, values[i]);
+    finish_output(chunk.buffer, line);
+}
+
+void CyclicOut::cycle_parallel() {
+    const auto chunk_count = static_cast<long>(chunks.size());
+#ifdef _OPENMP
+    const auto num_threads = static_cast<int>(threads);
+    if (schedule == schedule_t::work_stealing) {
+#    pragma omp parallel for num_threads(num_threads) schedule(dynamic, 1)
+        for (long chunk = 0; chunk < chunk_count; ++chunk)
+            format_chunk(static_cast<std::size_t>(chunk));
+    } else {
+#    pragma omp parallel for num_threads(num_threads) schedule(static)
+        for (long chunk = 0; chunk < chunk_count; ++chunk)
+            format_chunk(static_cast<std::size_t>(chunk));
+    }
+#else
+    for (long chunk = 0; chunk < chunk_count; ++chunk)
+        format_chunk(static_cast<std::size_t>(chunk));
+#endif
+
+    // join in signal order
+    for (const auto &chunk : chunks)
+        out.write(chunk.buffer.data(), static_cast<std::streamsize>(chunk.buffer.size()));
+    out.flush();
+}
+
+/** \brief CLOCK_MONOTONIC in ns */
+static int64_t monotonic_ns() {
+    timespec ts {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void CyclicOut::schedule_groups(std::size_t default_cycle_ms) {
+    if (default_cycle_ms == 0) throw std::invalid_argument("cycle time must not be 0");
+    if (threads > 1) throw std::logic_error("parallel output can not be combined with signal groups");
+
+    const auto start = monotonic_ns();
+    periods.clear();
+    deadlines.clear();
+    for (std::size_t i = 0; i < groups.size(); ++i) {
+        const auto cycle_ms = groups[i].cycle_ms ? groups[i].cycle_ms : default_cycle_ms;
+        periods.push_back(static_cast<int64_t>(cycle_ms) * 1000000);
+        deadlines.push_back({start, i});
+    }
+    std::make_heap(deadlines.begin(), deadlines.end(), std::greater<>());
+    due.reserve(groups.size());
+
+    scheduled = true;
+}
+
+bool CyclicOut::wait_groups() const {
+    const auto deadline = deadlines.front().time;
+    timespec   ts {};
+    ts.tv_sec  = deadline / 1000000000;
+    ts.tv_nsec = deadline % 1000000000;
+    return clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == 0;
+}
+
+void CyclicOut::cycle_groups() {
+    const auto now = monotonic_ns();
+
+    due.clear();
+    while (deadlines.front().time <= now) {
+        std::pop_heap(deadlines.begin(), deadlines.end(), std::greater<>());
+        auto      &deadline = deadlines.back();
+        const auto period   = periods[deadline.group];
+        due.push_back(deadline.group);
+
+        // next deadline in the future (missed deadlines are skipped, the phase is kept)
+        deadline.time += ((now - deadline.time) / period + 1) * period;
+        std::push_heap(deadlines.begin(), deadlines.end(), std::greater<>());
+    }
+
+    // decode all due groups before formatting, output in signal list order
+    std::sort(due.begin(), due.end());
+    for (const auto group_index : due)
+        decode_signals(group_index);
+    for (const auto group_index : due) {
+        const auto &group = groups[group_index];
+        for (auto i = group.first; i < group.first + group.count; ++i)
+            output_signal(i);
+    }
+    flush_output();
 }
@@ -9,7 +9,78 @@
 
 class CyclicOut : public MbOut {
 public:
-    CyclicOut(const std::string &path, std::ostream &out, const std::string &name_prefix = "modbus_")
-        : MbOut(path, out, name_prefix) {}
+    enum class schedule_t {
+        static_chunks, /**< each thread processes a fixed share of the chunks */
+        work_stealing, /**< threads take the next unprocessed chunk when they are done */
+    };
+
+    CyclicOut(const std::string &path,
+              std::ostream      &out,
+              const std::string &name_prefix  = "modbus_",
+              float_format_t     float_format = float_format_t::scientific)
+        : MbOut(path, out, name_prefix, float_format) {}
     void cycle() override;
+
+    /**
+     * \brief decode and format the signals in parallel
+     *
+     * The signal list is split into chunks of chunk_size signals. Each chunk is decoded (own BatchDecoder), scaled
+     * (own range of scaling entries) and formatted into its own buffer by one of the worker threads (OpenMP). The
+     * buffers are written in the order of the signal list.
+     *
+     * @param threads number of worker threads (1: disabled)
+     * @param chunk_size number of signals per chunk
+     * @param schedule distribution of the chunks to the threads
+     */
+    void set_parallel(std::size_t threads, std::size_t chunk_size, schedule_t schedule = schedule_t::static_chunks);
+
+    /**
+     * \brief output signal groups with individual cycle times (@cycle directive in the signal list)
+     *
+     * The deadlines of the groups are absolute times (CLOCK_MONOTONIC), starting now. Afterwards cycle() outputs only
+     * the groups whose deadline has passed; wait_groups() sleeps until the next deadline. The signals of the groups
+     * that are due together are decoded one after another before any of them is formatted, and they are written
+     * together (one write). Deadlines that were missed completely are skipped.
+     *
+     * @param default_cycle_ms cycle time of the signals before the first @cycle directive
+     */
+    void schedule_groups(std::size_t default_cycle_ms);
+
+    /**
+     * \brief sleep until the next group is due (see schedule_groups())
+     * @return false if the sleep was interrupted by a signal
+     */
+    bool wait_groups() const;
+
+private:
+    struct deadline_t {
+        int64_t     time;   // time at which the group is due (CLOCK_MONOTONIC, ns)
+        std::size_t group;  // index in groups
+
+        bool operator>(const deadline_t &other) const {
+            return time > other.time || (time == other.time && group > other.group);
+        }
+    };
+
+    bool                     scheduled = false;
+    std::vector<int64_t>     periods;    // cycle time of each group in ns
+    std::vector<deadline_t>  deadlines;  // min heap
+    std::vector<std::size_t> due;        // groups that are due in the current cycle
+
+    /** chunk of the signal list that is decoded, scaled and formatted by one worker thread */
+    struct chunk_t {
+        BatchDecoder decoder;
+        std::size_t  first_scaled = 0;  // index of the first scaling entry of the chunk
+        std::size_t  scaled_count = 0;  // number of scaled signals
+        std::string  buffer;            // output of the chunk
+    };
+
+    std::size_t          threads    = 1;
+    std::size_t          chunk_size = 0;
+    schedule_t           schedule   = schedule_t::static_chunks;
+    std::vector<chunk_t> chunks;
+
+    void format_chunk(std::size_t chunk);
+    void cycle_parallel();
+    void cycle_groups();
 };
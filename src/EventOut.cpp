@@ -3,75 +3,367 @@
  * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
  */
 
+#include <algorithm>
 #include <cstring>
+#include <ctime>
 #include <ostream>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#    include <immintrin.h>
+#endif
 
 #include "EventOut.hpp"
 
-EventOut::EventOut(const std::string &path, std::ostream &out, const std::string &name_prefix)
-    : MbOut(path, out, name_prefix) {
-    local_do = std::make_unique<uint8_t[]>(modbus_do.get_size());
-    local_di = std::make_unique<uint8_t[]>(modbus_di.get_size());
-    local_ao = std::make_unique<uint16_t[]>(modbus_ao.get_size() / 2);
-    local_ai = std::make_unique<uint16_t[]>(modbus_ai.get_size() / 2);
+/**
+ * \brief load the state of up to 64 coils (one byte per coil) as bit mask
+ * @param coils address of the first coil
+ * @param count number of coils (<= 64)
+ * @return bit i: coil i is not 0
+ */
+static inline uint64_t load_coils(const uint8_t *coils, std::size_t count) {
+    uint64_t mask = 0;
+    if (count == 64) {
+#if defined(__AVX2__)
+        const auto zero = _mm256_setzero_si256();
+        const auto lo   = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(coils));
+        const auto hi   = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(coils + 32));
+        const auto z_lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, zero)));
+        const auto z_hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, zero)));
+        return ~((static_cast<uint64_t>(z_hi) << 32) | z_lo);
+#elif defined(__SSE2__)
+        const auto zero = _mm_setzero_si128();
+        for (std::size_t i = 0; i < 4; ++i) {
+            const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(coils + i * 16));
+            const auto z = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)));
+            mask |= static_cast<uint64_t>(~z & 0xFFFF) << (i * 16);
+        }
+        return mask;
+#endif
+    }
 
-    memcpy(local_do.get(), modbus_do.get_addr(), modbus_do.get_size());
-    memcpy(local_di.get(), modbus_di.get_addr(), modbus_di.get_size());
-    memcpy(local_ao.get(), modbus_ao.get_addr(), (modbus_ao.get_size() / 2) * 2);
-    memcpy(local_ai.get(), modbus_ai.get_addr(), (modbus_ai.get_size() / 2) * 2);
+    for (std::size_t i = 0; i < count; ++i)
+        mask |= static_cast<uint64_t>(coils[i] != 0) << i;
+    return mask;
 }
 
-void EventOut::cycle() {
-    bool output = false;
+EventOut::EventOut(const std::string &path,
+                   std::ostream      &out,
+                   const std::string &name_prefix,
+                   float_format_t     float_format)
+    : MbOut(path, out, name_prefix, float_format) {
+    // group coils to runs
+    for (std::size_t i = 0; i < signals.size(); ++i) {
+        const auto &signal = signals[i];
+        if (signal.data_type != data_type_t::bit) continue;
+
+        if (!coil_runs.empty()) {
+            auto       &run  = coil_runs.back();
+            const auto &last = signals[run.first_signal + run.count - 1];
+            if (run.first_signal + run.count == i && last.register_type == signal.register_type &&
+                last.base_index + 1 == signal.base_index) {
+                ++run.count;
+                continue;
+            }
+        }
+        coil_runs.push_back({i, 1, signal_addr(signal), nullptr});
+    }
+
+    // shadow layout
+    std::vector<std::size_t> run_offsets;
+    run_offsets.reserve(coil_runs.size());
+    shadow_entries.reserve(signals.size());
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < signals.size();) {
+        if (run < coil_runs.size() && coil_runs[run].first_signal == i) {
+            const auto &coil_run = coil_runs[run];
+            shadow_size          = (shadow_size + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+            run_offsets.push_back(shadow_size);
+            for (std::size_t k = 0; k < coil_run.count; ++k)
+                shadow_entries.push_back({coil_run.shm + k, shadow_size * 8 + k, 0});
+            shadow_size += (coil_run.count + 63) / 64 * sizeof(uint64_t);
+            i += coil_run.count;
+            ++run;
+            continue;
+        }
+
+        const auto &signal = signals[i];
+        const auto  size   = data_type_registers(signal.data_type) * register_bytes(signal.register_type);
+        shadow_entries.push_back({signal_addr(signal), shadow_size, size});
+        shadow_size += size;
+        ++i;
+    }
+
+    shadow_storage.resize((shadow_size + sizeof(cache_line_t) - 1) / sizeof(cache_line_t));
+    shadow = reinterpret_cast<uint8_t *>(shadow_storage.data());
+
+    for (std::size_t r = 0; r < coil_runs.size(); ++r) {
+        auto &coil_run = coil_runs[r];
+        coil_run.bits  = reinterpret_cast<uint64_t *>(shadow + run_offsets[r]);
+        for (std::size_t k = 0; k < coil_run.count; k += 64)
+            coil_run.bits[k / 64] = load_coils(coil_run.shm + k, std::min<std::size_t>(64, coil_run.count - k));
+    }
+
+    for (const auto &entry : shadow_entries)
+        if (entry.size) memcpy(shadow + entry.offset, entry.shm, entry.size);
+
+    scaled_values.resize(scaling.size());
+    for (const auto i : scaled_signals)
+        scaled_values[signals[i].scaling] = shadow_value(i).f64;
+
+    keyframe_pos = signals.size();
+}
+
+/** \brief CLOCK_MONOTONIC in ns */
+static int64_t monotonic_ns() {
+    timespec ts {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void EventOut::set_keyframes(std::size_t interval_ms, std::size_t spread) {
+    if (spread == 0) throw std::invalid_argument("keyframe spread must not be 0");
+    keyframe_interval = static_cast<int64_t>(interval_ms) * 1000000;
+    keyframe_next     = monotonic_ns() + keyframe_interval;
+    keyframe_spread   = spread;
+    keyframe_pos      = signals.size();
+}
+
+void EventOut::enable_profile() {
+    profile = std::make_unique<ChangeProfile>(signals.size(), monotonic_ns());
+}
+
+void EventOut::report_profile(std::ostream &out) const {
+    if (!profile) return;
+
+    std::vector<std::string> names;
+    names.reserve(signals.size());
+    for (const auto &signal : signals) {
+        char name[MAX_LINE_CHARS];
+        names.emplace_back(name, format_name(name, signal));
+    }
+    profile->report(out, names);
+}
+
+/** \brief CLOCK_REALTIME in ns */
+static int64_t realtime_ns() {
+    timespec ts {};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void EventOut::move_shadow(uint8_t *new_shadow) {
+    for (auto &coil_run : coil_runs) {
+        const auto offset = reinterpret_cast<uint8_t *>(coil_run.bits) - shadow;
+        coil_run.bits     = reinterpret_cast<uint64_t *>(new_shadow + offset);
+    }
+    shadow = new_shadow;
+}
+
+StateFile::status_t EventOut::set_state_file(const std::string &path) {
+    // the layout of the shadow is determined by the signal list
+    uint64_t hash = StateFile::HASH_INIT;
     for (const auto &signal : signals) {
-        bool diff  = false;
-        auto cells = data_type_registers(signal.data_type);
+        hash = StateFile::hash(hash, &signal.data_type, sizeof(signal.data_type));
+        hash = StateFile::hash(hash, &signal.register_type, sizeof(signal.register_type));
+        hash = StateFile::hash(hash, &signal.base_index, sizeof(signal.base_index));
+    }
+
+    state = std::make_unique<StateFile>(path, hash, shadow_size);
+    if (state->status() == StateFile::status_t::loaded) {
+        move_shadow(state->data());
+        for (const auto i : scaled_signals)
+            scaled_values[signals[i].scaling] = shadow_value(i).f64;
+    } else {
+        memcpy(state->data(), shadow, shadow_size);
+        move_shadow(state->data());
+        state->commit();
+    }
+
+    shadow_storage.clear();
+    shadow_storage.shrink_to_fit();
+    return state->status();
+}
+
+void EventOut::set_event_ring(const std::string &name, std::size_t capacity) {
+    std::vector<shm_table_descriptor_t> descriptors;
+    descriptors.reserve(signals.size());
+    for (const auto &signal : signals)
+        descriptors.push_back(ShmTableOut::describe_signal(signal));
+
+    ring           = std::make_unique<EventRing>(name, capacity, descriptors);
+    ring_timestamp = realtime_ns();
+    for (std::size_t i = 0; i < signals.size(); ++i)
+        ring->append(ring_timestamp, i, EVENT_RECORD_KEYFRAME, shadow_value(i));
+    ring->publish();
+}
+
+value_t EventOut::shadow_value(std::size_t signal_index) const {
+    const auto &entry = shadow_entries[signal_index];
+    if (entry.size == 0) {
+        value_t value {};
+        value.u = (reinterpret_cast<const uint64_t *>(shadow)[entry.offset / 64] >> (entry.offset % 64)) & 1;
+        return value;
+    }
+    return decode_signal(signals[signal_index], shadow + entry.offset);
+}
+
+void EventOut::scan_coils(const coil_run_t &run) {
+    for (std::size_t k = 0; k < run.count; k += 64) {
+        const auto     count   = std::min<std::size_t>(64, run.count - k);
+        const uint64_t state   = load_coils(run.shm + k, count);
+        const uint64_t changed = state ^ run.bits[k / 64];
+        if (!changed) continue;
+        run.bits[k / 64] = state;
 
-        switch (signal.register_type) {
-            case register_type_t::DO: {
-                diff = local_do[signal.base_index] != modbus_do.at<uint8_t>(signal.base_index);
-                break;
+        if (profile) {
+            for (auto c = changed; c; c &= c - 1)
+                profile->change(run.first_signal + k + static_cast<std::size_t>(__builtin_ctzll(c)));
+        }
+
+        const auto &first = signals[run.first_signal + k];
+        if (coil_groups) {
+            char  line[MAX_LINE_CHARS];
+            char *p = line;
+            memcpy(p, first.register_type == register_type_t::DO ? "do:" : "di:", 3);
+            p += 3;
+            p = format::dec(p, first.base_index);
+            memcpy(p, "..", 2);
+            p += 2;
+            p = format::dec(p, first.base_index + count - 1);
+            *p++ = ':';
+            p    = format::hex(p, state);
+            *p++ = '\n';
+            out_buffer.append(line, p);
+        } else {
+            for (auto c = changed; c; c &= c - 1) {
+                const auto bit = static_cast<std::size_t>(__builtin_ctzll(c));
+                value_t    value {};
+                value.u = (state >> bit) & 1;
+                output_change(run.first_signal + k + bit, value);
             }
-            case register_type_t::DI:
-                diff = local_di[signal.base_index] != modbus_di.at<uint8_t>(signal.base_index);
-                break;
-            case register_type_t::AO:
-                for (size_t i = 0; i < cells; ++i) {
-                    if (local_ao[signal.base_index + i] != modbus_ao.at<uint16_t>(signal.base_index + i)) {
-                        diff = true;
-                        break;
-                    }
-                }
-                break;
-            case register_type_t::AI:
-                for (size_t i = 0; i < cells; ++i) {
-                    if (local_ai[signal.base_index + i] != modbus_ai.at<uint16_t>(signal.base_index + i)) {
-                        diff = true;
-                        break;
-                    }
-                }
-                break;
         }
+    }
+}
+
+void EventOut::output_keyframe() {
+    const auto now = monotonic_ns();
+    if (now >= keyframe_next) {
+        // start new keyframe (an unfinished one is restarted); missed start times are skipped, the phase is kept
+        keyframe_next += ((now - keyframe_next) / keyframe_interval + 1) * keyframe_interval;
+        keyframe_pos = 0;
+    }
+
+    if (keyframe_pos >= signals.size()) return;
+
+    const auto per_cycle = (signals.size() + keyframe_spread - 1) / keyframe_spread;
+    const auto end       = std::min(signals.size(), keyframe_pos + per_cycle);
+    for (; keyframe_pos < end; ++keyframe_pos) {
+        const auto &signal = signals[keyframe_pos];
+        const auto  value  = shadow_value(keyframe_pos);
+
+        if (ring) {
+            ring->append(ring_timestamp, keyframe_pos, EVENT_RECORD_KEYFRAME, value);
+            continue;
+        }
+
+        // line protocol: no keyframe marker (the points of a keyframe are regular points)
+        if (influx) {
+            append_signal(out_buffer, influx_line, keyframe_pos, value);
+            continue;
+        }
+
+        char line[MAX_LINE_CHARS + 3];
+        memcpy(line, "kf:", 3);
+        auto line_end = format_signal(line + 3, signal, value);
+        out_buffer.append(line, line_end);
+    }
+}
+
+/**
+ * \brief compare two scaled values (NaN is equal to NaN)
+ */
+static inline bool same_value(double a, double b) {
+    uint64_t bits_a, bits_b;
+    memcpy(&bits_a, &a, sizeof(bits_a));
+    memcpy(&bits_b, &b, sizeof(bits_b));
+    return bits_a == bits_b;
+}
+
+/**
+ * \brief compare the shadow of a signal with the shared memory
+ */
+static inline bool differs(const uint8_t *shadow, const uint8_t *shm, std::size_t size) {
+    switch (size) {
+        case 1: return *shadow != *shm;
+        case 2: {
+            uint16_t a, b;
+            memcpy(&a, shadow, sizeof(a));
+            memcpy(&b, shm, sizeof(b));
+            return a != b;
+        }
+        case 4: {
+            uint32_t a, b;
+            memcpy(&a, shadow, sizeof(a));
+            memcpy(&b, shm, sizeof(b));
+            return a != b;
+        }
+        case 8: {
+            uint64_t a, b;
+            memcpy(&a, shadow, sizeof(a));
+            memcpy(&b, shm, sizeof(b));
+            return a != b;
+        }
+        default: return memcmp(shadow, shm, size) != 0;
+    }
+}
+
+void EventOut::cycle() {
+    begin_output();
+    if (profile) profile->begin_poll(monotonic_ns());
+    if (ring) ring_timestamp = realtime_ns();
+
+    // the shadow is the last output state: it is not valid until the output of the cycle is written
+    if (state) state->begin_update();
 
-        if (diff) {
-            output = true;
-            output_signal(signal);
-            switch (signal.register_type) {
-                case register_type_t::DO: local_do[signal.base_index] = modbus_do.at<uint8_t>(signal.base_index); break;
-                case register_type_t::DI: local_di[signal.base_index] = modbus_di.at<uint8_t>(signal.base_index); break;
-                case register_type_t::AO:
-                    for (size_t i = 0; i < cells; ++i) {
-                        local_ao[signal.base_index + i] = modbus_ao.at<uint16_t>(signal.base_index + i);
-                    }
-                    break;
-                case register_type_t::AI:
-                    for (size_t i = 0; i < cells; ++i) {
-                        local_ai[signal.base_index + i] = modbus_ai.at<uint16_t>(signal.base_index + i);
-                    }
-                    break;
-            };
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < signals.size();) {
+        if (run < coil_runs.size() && coil_runs[run].first_signal == i) {
+            scan_coils(coil_runs[run]);
+            i += coil_runs[run].count;
+            ++run;
+            continue;
         }
 
-        if (output) out << std::flush;
+        const auto &entry = shadow_entries[i];
+        auto       *local = shadow + entry.offset;
+
+        if (differs(local, entry.shm, entry.size)) {
+            // output the copied value (the shared memory might have changed in the meantime)
+            memcpy(local, entry.shm, entry.size);
+            if (profile) profile->change(i);
+
+            const auto &signal = signals[i];
+            const auto  value  = decode_signal(signal, local);
+
+            // raw changes that do not change the scaled value (e.g. clamped values) are not output
+            if (signal.scaled()) {
+                auto &last = scaled_values[signal.scaling];
+                if (same_value(last, value.f64)) {
+                    ++i;
+                    continue;
+                }
+                last = value.f64;
+            }
+
+            output_change(i, value);
+        }
+        ++i;
     }
+
+    if (keyframe_interval) output_keyframe();
+
+    if (ring) ring->publish();
+    flush_output();
+    if (state) state->end_update();
 }
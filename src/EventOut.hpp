@@ -5,19 +5,149 @@
 
 #pragma once
 
+#include "ChangeProfile.hpp"
+#include "EventRing.hpp"
 #include "MbOut.hpp"
+#include "StateFile.hpp"
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <ostream>
+#include <vector>
 
 class EventOut : public MbOut {
 private:
-    std::unique_ptr<uint8_t[]>  local_do;
-    std::unique_ptr<uint8_t[]>  local_di;
-    std::unique_ptr<uint16_t[]> local_ao;
-    std::unique_ptr<uint16_t[]> local_ai;
+    struct alignas(64) cache_line_t {
+        uint8_t data[64];
+    };
+
+    struct shadow_entry_t {
+        const uint8_t *shm;     // address of the signal in the shared memory
+        std::size_t    offset;  // offset of the signal in the shadow (bit offset for coils)
+        std::size_t    size;    // size of the signal in bytes (0 for coils)
+    };
+
+    /** consecutive coils (do/di) with consecutive indices */
+    struct coil_run_t {
+        std::size_t    first_signal;  // index of the signal of the first coil
+        std::size_t    count;         // number of coils
+        const uint8_t *shm;           // address of the first coil in the shared memory
+        uint64_t      *bits;          // coil states in the shadow (bit i of bits[i / 64]: coil i)
+    };
+
+    /*
+     * The shadow holds the last output state of all signals. It contains only the bytes that are covered by the
+     * signals, packed in the order of the signals (= scan order). Coils are packed 64 per 64 bit word.
+     */
+    std::vector<cache_line_t>   shadow_storage;
+    uint8_t                    *shadow;
+    std::size_t                 shadow_size = 0;
+    std::unique_ptr<StateFile>  state;  // shadow in a state file (nullptr: shadow_storage)
+    std::vector<shadow_entry_t> shadow_entries;  // one entry per signal
+    std::vector<coil_run_t>     coil_runs;
+
+    /** last output value of the scaled signals (indexed by the scaling index) */
+    std::vector<double> scaled_values;
+
+    bool coil_groups = false;
+
+    /** change statistics (nullptr: disabled) */
+    std::unique_ptr<ChangeProfile> profile;
+
+    /** shared memory ring of change records (nullptr: text output) */
+    std::unique_ptr<EventRing> ring;
+    int64_t                    ring_timestamp = 0;  // time of the current poll (unix time in ns)
+
+    int64_t     keyframe_interval = 0;  // ns (0: disabled)
+    int64_t     keyframe_next     = 0;  // start time of the next keyframe (CLOCK_MONOTONIC, ns)
+    std::size_t keyframe_spread   = 1;  // cycles
+    std::size_t keyframe_pos      = 0;  // next signal of the current keyframe (signals.size(): no keyframe active)
+
+    /**
+     * \brief decode the value of a signal from the shadow
+     */
+    [[nodiscard]] value_t shadow_value(std::size_t signal_index) const;
+
+    void scan_coils(const coil_run_t &run);
+
+    void output_keyframe();
+
+    /** \brief move the shadow to another memory (the content is not copied) */
+    void move_shadow(uint8_t *new_shadow);
+
+    /** \brief output a changed signal (to the event ring or as text) */
+    void output_change(std::size_t signal_index, value_t value, uint32_t ring_flags = 0) {
+        if (ring) ring->append(ring_timestamp, signal_index, ring_flags, value);
+        else
+            append_signal(out_buffer, influx_line, signal_index, value);
+    }
+
+protected:
+    /** changes and keyframe lines ("kf:" prefix) in the same cycle */
+    [[nodiscard]] std::size_t max_cycle_output() const override { return signals.size() * (2 * MAX_LINE_CHARS + 3); }
 
 public:
-    EventOut(const std::string &path, std::ostream &out, const std::string &name_prefix = "modbus_");
+    EventOut(const std::string &path,
+             std::ostream      &out,
+             const std::string &name_prefix  = "modbus_",
+             float_format_t     float_format = float_format_t::scientific);
     void cycle() override;
+
+    /**
+     * \brief enable periodic keyframes
+     *
+     * A keyframe contains the last output state of all signals. The output lines are prefixed by "kf:".
+     * Keyframes are generated from the local state (no additional shared memory access).
+     * A keyframe starts in the first cycle after its start time (CLOCK_MONOTONIC, independent of the cycle time and of
+     * change notifications).
+     *
+     * @param interval_ms keyframe interval in milliseconds (0: disabled)
+     * @param spread number of cycles the output of one keyframe is distributed to
+     */
+    void set_keyframes(std::size_t interval_ms, std::size_t spread = 1);
+
+    /**
+     * \brief output changed coils as groups
+     *
+     * Each group of up to 64 consecutive coils that contains a changed coil is written as one line:
+     * <register type>:<first index>..<last index>:<hex mask> (bit i of the mask: state of coil first index + i)
+     */
+    void set_coil_groups(bool enable) { coil_groups = enable; }
+
+    /**
+     * \brief count the changes of each signal (see ChangeProfile)
+     *
+     * All raw changes are counted (also changes of coils in groups and changes that do not change a scaled value).
+     */
+    void enable_profile();
+
+    /**
+     * \brief write the change statistics (sorted by number of changes)
+     * @param out output stream
+     */
+    void report_profile(std::ostream &out) const;
+
+    /**
+     * \brief keep the shadow in a memory mapped state file
+     *
+     * If the file contains the state of the same signal list, the shadow is replaced by the stored state: the next
+     * cycle outputs only the signals that differ from the last output state before the restart. Otherwise the current
+     * shadow is written to the file.
+     * Must be called before set_event_ring().
+     *
+     * @param path path of the state file
+     * @return status of the state file
+     */
+    StateFile::status_t set_state_file(const std::string &path);
+
+    /**
+     * \brief write change records to a shared memory ring instead of the text output (see EventRing.hpp)
+     *
+     * The current state of all signals is written to the ring as keyframe.
+     *
+     * @param name name of the shared memory (must not exist)
+     * @param capacity number of records (rounded up to a power of 2)
+     */
+    void set_event_ring(const std::string &name, std::size_t capacity);
 };
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "EventRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+
+EventRing::EventRing(const std::string                         &name,
+                     std::size_t                                capacity,
+                     const std::vector<shm_table_descriptor_t> &descriptors) {
+    if (capacity == 0 || capacity > (std::size_t(1) << 31)) throw std::runtime_error("invalid event ring size");
+    std::size_t slots = 1;
+    while (slots < capacity)
+        slots <<= 1;
+
+    const auto n = descriptors.size();
+    if (n > std::numeric_limits<uint32_t>::max()) throw std::runtime_error("too many signals for event ring");
+
+    const std::size_t descriptor_offset = sizeof(event_ring_header_t);
+    const std::size_t record_offset     = (descriptor_offset + n * sizeof(shm_table_descriptor_t) + 63) / 64 * 64;
+    const std::size_t size              = record_offset + slots * sizeof(event_record_t);
+    if (record_offset > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("too many signals for event ring");
+
+    shm        = std::make_unique<cxxshm::SharedMemory>(name, size, false, true);
+    auto *base = shm->get_addr<uint8_t *>();
+    memset(base, 0, size);
+
+    std::copy(descriptors.begin(),
+              descriptors.end(),
+              reinterpret_cast<shm_table_descriptor_t *>(base + descriptor_offset));
+
+    records = reinterpret_cast<event_record_t *>(base + record_offset);
+    for (std::size_t i = 0; i < slots; ++i)
+        new (records + i) event_record_t();
+    mask = slots - 1;
+
+    header                    = new (base) event_ring_header_t();
+    header->version           = EVENT_RING_VERSION;
+    header->header_size       = sizeof(event_ring_header_t);
+    header->signal_count      = static_cast<uint32_t>(n);
+    header->capacity          = static_cast<uint32_t>(slots);
+    header->descriptor_offset = static_cast<uint32_t>(descriptor_offset);
+    header->descriptor_size   = sizeof(shm_table_descriptor_t);
+    header->record_offset     = static_cast<uint32_t>(record_offset);
+    header->record_size       = sizeof(event_record_t);
+    header->head.store(0, std::memory_order_relaxed);
+
+    // written last: readers can check the magic to see if the ring is initialized
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = EVENT_RING_MAGIC;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "ShmTableOut.hpp"
+#include "decode.hpp"
+
+#include "cxxshm.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Layout of the event ring (native byte order, all offsets relative to the start of the segment):
+ *
+ * offset              | content
+ * --------------------+------------------------------------------------------
+ * 0                   | event_ring_header_t
+ * descriptor_offset   | shm_table_descriptor_t[signal_count] (constant, see ShmTableOut.hpp)
+ * record_offset       | event_record_t[capacity] (capacity: power of 2)
+ *
+ * Each change is a record with a sequence number (1, 2, 3, ...). Record n is stored in slot n % capacity.
+ * The value has the same format as a value slot of the shared memory table (see value_kind of the descriptor).
+ *
+ * There is one writer and any number of readers; readers do not write to the segment. Each reader keeps its own
+ * cursor (sequence number of the next record, e.g. head + 1 to get only new records):
+ *  1. h = head (acquire); nothing new if cursor > h
+ *  2. if h - cursor >= capacity: the records cursor .. h - capacity were overwritten (overrun), set cursor to
+ *     h - capacity + 1
+ *  3. slot = records[cursor % capacity]; s1 = slot.sequence (acquire)
+ *  4. copy the record; acquire fence; s2 = slot.sequence
+ *  5. if s1 != cursor or s2 != cursor: the record was overwritten (overrun), continue with 1.
+ *  6. cursor += 1, continue with 3. while cursor <= h
+ *
+ * head is updated once per poll, after all records of the poll are written.
+ */
+
+static constexpr uint32_t EVENT_RING_MAGIC   = 0x5245424D;  // "MBER"
+static constexpr uint16_t EVENT_RING_VERSION = 1;
+
+static constexpr uint32_t EVENT_RECORD_KEYFRAME = 0x01;  // record is part of a keyframe (not a change)
+
+struct alignas(64) event_ring_header_t {
+    uint32_t              magic;              /**< EVENT_RING_MAGIC */
+    uint16_t              version;            /**< EVENT_RING_VERSION */
+    uint16_t              header_size;        /**< sizeof(event_ring_header_t) */
+    uint32_t              signal_count;       /**< number of signals */
+    uint32_t              capacity;           /**< number of record slots (power of 2) */
+    uint32_t              descriptor_offset;  /**< offset of the descriptor table */
+    uint32_t              descriptor_size;    /**< size of one descriptor */
+    uint32_t              record_offset;      /**< offset of the first record slot (64 byte aligned) */
+    uint32_t              record_size;        /**< size of one record slot */
+    std::atomic<uint64_t> head;               /**< sequence number of the last published record (0: none) */
+};
+
+struct event_record_t {
+    std::atomic<uint64_t> sequence;      /**< sequence number of the record (0: slot is written) */
+    int64_t               timestamp_ns;  /**< time of the poll that detected the change (unix time in ns) */
+    uint32_t              signal;        /**< index of the signal (descriptor table) */
+    uint32_t              flags;         /**< EVENT_RECORD_* */
+    uint64_t              value;         /**< decoded value (as value slot of the shared memory table) */
+};
+
+static_assert(sizeof(event_ring_header_t) == 64);
+static_assert(sizeof(event_record_t) == 32);
+
+/**
+ * \brief single producer, multi reader ring of change records in a shared memory
+ */
+class EventRing {
+private:
+    std::unique_ptr<cxxshm::SharedMemory> shm;
+    event_ring_header_t                  *header  = nullptr;
+    event_record_t                       *records = nullptr;
+    uint64_t                              mask    = 0;
+    uint64_t                              next    = 1;  // sequence number of the next record
+
+public:
+    /**
+     * \brief create event ring
+     * @param name name of the shared memory (must not exist)
+     * @param capacity number of records (rounded up to a power of 2)
+     * @param descriptors signal descriptors
+     */
+    EventRing(const std::string &name, std::size_t capacity, const std::vector<shm_table_descriptor_t> &descriptors);
+
+    /** \brief write a record (not visible to readers before publish()) */
+    void append(int64_t timestamp_ns, std::size_t signal, uint32_t flags, value_t value) noexcept {
+        auto &record = records[next & mask];
+        record.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        record.timestamp_ns = timestamp_ns;
+        record.signal       = static_cast<uint32_t>(signal);
+        record.flags        = flags;
+        record.value        = value.u;
+        record.sequence.store(next, std::memory_order_release);
+        ++next;
+    }
+
+    /** \brief make the appended records visible to the readers */
+    void publish() noexcept { header->head.store(next - 1, std::memory_order_release); }
+};
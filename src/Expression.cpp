@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Expression.hpp"
+
+#include "decode.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+Expression::Expression(const std::string &expression, const std::string &name_prefix)
+    : expression(expression), name_prefix(name_prefix), shms(4) {
+    skip_space();
+    if (pos == expression.size()) error("empty expression");
+
+    expect(parse_or(), type_t::boolean, "expression");
+    skip_space();
+    if (pos != expression.size()) error("unexpected character");
+
+    stack.resize(max_depth);
+}
+
+/** boolean value of a stack entry (booleans are stored as 0.0 and 1.0) */
+static inline bool truth(double value) {
+    return std::islessgreater(value, 0.0);
+}
+
+/** a == b (without -Wfloat-equal: the comparison is intended) */
+static inline bool equal(double a, double b) {
+    return a <= b && a >= b;
+}
+
+bool Expression::evaluate() const {
+    double     *sp   = stack.data();
+    const auto *ip   = code.data();
+    const auto *end  = ip + code.size();
+    const auto *base = ip;
+
+    while (ip != end) {
+        const auto &instruction = *ip++;
+        switch (instruction.op) {
+            case op_t::push_const: *sp++ = constants[instruction.arg]; break;
+            case op_t::load: {
+                const auto &load = loads[instruction.arg];
+                *sp++            = value_to_double(load.kind, decode_value(load.data_type, load.addr));
+                break;
+            }
+            case op_t::neg: sp[-1] = -sp[-1]; break;
+            case op_t::logical_not: sp[-1] = truth(sp[-1]) ? 0.0 : 1.0; break;
+            case op_t::add: --sp, sp[-1] += sp[0]; break;
+            case op_t::sub: --sp, sp[-1] -= sp[0]; break;
+            case op_t::mul: --sp, sp[-1] *= sp[0]; break;
+            case op_t::div: --sp, sp[-1] /= sp[0]; break;
+            case op_t::eq: --sp, sp[-1] = equal(sp[-1], sp[0]) ? 1.0 : 0.0; break;
+            case op_t::ne: --sp, sp[-1] = equal(sp[-1], sp[0]) ? 0.0 : 1.0; break;
+            case op_t::lt: --sp, sp[-1] = sp[-1] < sp[0] ? 1.0 : 0.0; break;
+            case op_t::le: --sp, sp[-1] = sp[-1] <= sp[0] ? 1.0 : 0.0; break;
+            case op_t::gt: --sp, sp[-1] = sp[-1] > sp[0] ? 1.0 : 0.0; break;
+            case op_t::ge: --sp, sp[-1] = sp[-1] >= sp[0] ? 1.0 : 0.0; break;
+            case op_t::jump_if_false:
+                if (!truth(sp[-1])) ip = base + instruction.arg;
+                else
+                    --sp;
+                break;
+            case op_t::jump_if_true:
+                if (truth(sp[-1])) ip = base + instruction.arg;
+                else
+                    --sp;
+                break;
+            default: throw std::logic_error("unknown instruction");
+        }
+    }
+
+    return truth(sp[-1]);
+}
+
+void Expression::error(const std::string &what) const {
+    throw std::runtime_error("invalid expression '" + expression + "' at position " + std::to_string(pos + 1) + ": " +
+                             what);
+}
+
+void Expression::skip_space() {
+    while (pos < expression.size() && std::isspace(static_cast<unsigned char>(expression[pos])))
+        ++pos;
+}
+
+bool Expression::accept(const char *token) {
+    skip_space();
+    const auto len = strlen(token);
+    if (expression.compare(pos, len, token) != 0) return false;
+    pos += len;
+    return true;
+}
+
+void Expression::emit(op_t op, uint32_t arg) {
+    code.push_back({op, arg});
+}
+
+void Expression::push() {
+    if (++depth > max_depth) max_depth = depth;
+}
+
+void Expression::pop(std::size_t n) {
+    depth -= n;
+}
+
+void Expression::expect(type_t actual, type_t expected, const char *context) const {
+    if (actual != expected)
+        error(std::string(context) + " requires a " + (expected == type_t::boolean ? "boolean" : "numeric") +
+              " operand");
+}
+
+Expression::type_t Expression::parse_or() {
+    auto type = parse_and();
+    while (accept("||")) {
+        expect(type, type_t::boolean, "||");
+        const auto jump = code.size();
+        emit(op_t::jump_if_true);
+        pop();
+        expect(parse_and(), type_t::boolean, "||");
+        code[jump].arg = static_cast<uint32_t>(code.size());
+    }
+    return type;
+}
+
+Expression::type_t Expression::parse_and() {
+    auto type = parse_comparison();
+    while (accept("&&")) {
+        expect(type, type_t::boolean, "&&");
+        const auto jump = code.size();
+        emit(op_t::jump_if_false);
+        pop();
+        expect(parse_comparison(), type_t::boolean, "&&");
+        code[jump].arg = static_cast<uint32_t>(code.size());
+    }
+    return type;
+}
+
+Expression::type_t Expression::parse_comparison() {
+    const auto lhs = parse_sum();
+
+    static constexpr struct {
+        const char *token;
+        op_t        op;
+        bool        relational;
+    } OPERATORS[] = {
+            {"==", op_t::eq, false},
+            {"!=", op_t::ne, false},
+            {"<=", op_t::le, true},
+            {">=", op_t::ge, true},
+            {"<", op_t::lt, true},
+            {">", op_t::gt, true},
+    };
+
+    for (const auto &op : OPERATORS) {
+        if (!accept(op.token)) continue;
+
+        const auto rhs = parse_sum();
+        if (op.relational) {
+            expect(lhs, type_t::numeric, op.token);
+            expect(rhs, type_t::numeric, op.token);
+        } else if (lhs != rhs) {
+            error(std::string("operands of ") + op.token + " have different types");
+        }
+        emit(op.op);
+        pop();
+        return type_t::boolean;
+    }
+
+    return lhs;
+}
+
+Expression::type_t Expression::parse_sum() {
+    auto type = parse_product();
+    for (;;) {
+        op_t op;
+        if (accept("+")) op = op_t::add;
+        else if (accept("-"))
+            op = op_t::sub;
+        else
+            return type;
+
+        expect(type, type_t::numeric, op == op_t::add ? "+" : "-");
+        expect(parse_product(), type_t::numeric, op == op_t::add ? "+" : "-");
+        emit(op);
+        pop();
+    }
+}
+
+Expression::type_t Expression::parse_product() {
+    auto type = parse_unary();
+    for (;;) {
+        op_t op;
+        if (accept("*")) op = op_t::mul;
+        else if (accept("/"))
+            op = op_t::div;
+        else
+            return type;
+
+        expect(type, type_t::numeric, op == op_t::mul ? "*" : "/");
+        expect(parse_unary(), type_t::numeric, op == op_t::mul ? "*" : "/");
+        emit(op);
+        pop();
+    }
+}
+
+Expression::type_t Expression::parse_unary() {
+    skip_space();
+    // do not mistake != for !
+    if (expression.compare(pos, 2, "!=") != 0 && accept("!")) {
+        expect(parse_unary(), type_t::boolean, "!");
+        emit(op_t::logical_not);
+        return type_t::boolean;
+    }
+    if (accept("-")) {
+        expect(parse_unary(), type_t::numeric, "unary -");
+        emit(op_t::neg);
+        return type_t::numeric;
+    }
+    return parse_primary();
+}
+
+Expression::type_t Expression::parse_primary() {
+    skip_space();
+    if (pos == expression.size()) error("unexpected end of expression");
+
+    if (accept("(")) {
+        const auto type = parse_or();
+        if (!accept(")")) error("missing ')'");
+        return type;
+    }
+
+    const auto c = expression[pos];
+    if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+        const char *begin = expression.c_str() + pos;
+        char       *end   = nullptr;
+        const auto  value = std::strtod(begin, &end);
+        if (end == begin) error("invalid number");
+        pos += static_cast<std::size_t>(end - begin);
+
+        emit(op_t::push_const, static_cast<uint32_t>(constants.size()));
+        constants.push_back(value);
+        push();
+        return type_t::numeric;
+    }
+
+    if (std::isalpha(static_cast<unsigned char>(c))) return parse_signal();
+
+    error("unexpected character");
+}
+
+Expression::type_t Expression::parse_signal() {
+    const auto start = pos;
+    auto       word  = [this]() {
+        const auto begin = pos;
+        while (pos < expression.size() &&
+               (std::isalnum(static_cast<unsigned char>(expression[pos])) || expression[pos] == '_'))
+            ++pos;
+        return expression.substr(begin, pos - begin);
+    };
+
+    const auto reg_str = word();
+    if (pos == expression.size() || expression[pos] != ':') error("expected <reg>:<index>");
+    ++pos;
+    const auto index_str = word();
+    std::string type_str;
+    if (pos < expression.size() && expression[pos] == ':') {
+        ++pos;
+        type_str = word();
+    }
+
+    try {
+        const auto reg_type  = str_to_register_type(reg_str);
+        const auto data_type = type_str.empty() ? data_type_t::bit : str_to_data_type(type_str);
+        const bool is_coil   = reg_type == register_type_t::DO || reg_type == register_type_t::DI;
+        if (is_coil != (data_type == data_type_t::bit))
+            throw std::runtime_error("data type invalid for specified register type");
+
+        std::size_t        idx = 0;
+        unsigned long long index;
+        try {
+            index = std::stoull(index_str, &idx, 0);
+        } catch (const std::exception &) { throw std::runtime_error("invalid register index format"); }
+        if (idx != index_str.size()) throw std::runtime_error("invalid register index format");
+
+        auto &shm = shms[static_cast<std::size_t>(reg_type)];
+        if (!shm) {
+            static constexpr const char *NAMES[] = {"DO", "DI", "AO", "AI"};
+            shm = std::make_unique<cxxshm::SharedMemory>(name_prefix + NAMES[static_cast<std::size_t>(reg_type)]);
+        }
+
+        const auto bytes = register_bytes(reg_type);
+        if ((index + data_type_registers(data_type)) * bytes > shm->get_size())
+            throw std::runtime_error("index out of range");
+
+        emit(op_t::load, static_cast<uint32_t>(loads.size()));
+        loads.push_back({data_type, data_type_value_kind(data_type), shm->get_addr<const uint8_t *>() + index * bytes});
+        push();
+        return is_coil ? type_t::boolean : type_t::numeric;
+    } catch (const std::runtime_error &e) {
+        pos = start;
+        error(e.what());
+    }
+}
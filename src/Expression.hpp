@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "data_types.hpp"
+
+#include "cxxshm.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * \brief condition on the values in the shared memory
+ *
+ * The expression is parsed and type checked once and compiled to a flat bytecode for a stack machine. Signal values
+ * are decoded directly from the shared memory when the expression is evaluated.
+ *
+ * The condition does not use the decoded values of the cycle: it is evaluated before the cycle, so a false condition
+ * skips decoding and formatting, and it may reference signals that are not part of the signal list. The shared
+ * memory is therefore read twice. If the modbus client writes in between, the output can contain values that
+ * differ from the values the condition was evaluated with (neither read is atomic anyway).
+ *
+ * Syntax:
+ *  - signals: <reg>:<index>[:<data type>] (as in the signal list, e.g. ai:10:f32b, di:3)
+ *  - numbers: decimal or floating point literals (e.g. 80, 1.5e3)
+ *  - operators (by increasing precedence): ||, &&, == != < <= > >=, + -, * /, ! - (unary)
+ *  - parentheses
+ *
+ * Coils (do/di) are boolean, all other signals and numbers are numeric. Comparisons result in a boolean value.
+ * The operands of !, && and || must be boolean, the operands of arithmetic operators and relational comparisons must
+ * be numeric. The expression must be boolean.
+ */
+class Expression final {
+public:
+    /**
+     * \brief compile expression
+     * @param expression expression string
+     * @param name_prefix shared memory name prefix
+     * @exception std::runtime_error invalid expression (the message contains the position)
+     */
+    explicit Expression(const std::string &expression, const std::string &name_prefix = "modbus_");
+
+    /**
+     * \brief evaluate the expression with the current values in the shared memory
+     */
+    [[nodiscard]] bool evaluate() const;
+
+    [[nodiscard]] const std::string &str() const noexcept { return expression; }
+
+private:
+    enum class op_t : uint8_t {
+        push_const,    /**< push constants[arg] */
+        load,          /**< push value of loads[arg] */
+        neg,           /**< -a */
+        logical_not,   /**< !a */
+        add,           /**< a + b */
+        sub,           /**< a - b */
+        mul,           /**< a * b */
+        div,           /**< a / b */
+        eq,            /**< a == b */
+        ne,            /**< a != b */
+        lt,            /**< a < b */
+        le,            /**< a <= b */
+        gt,            /**< a > b */
+        ge,            /**< a >= b */
+        jump_if_false, /**< if top is false: jump to arg (keep top), else pop (&&) */
+        jump_if_true,  /**< if top is true: jump to arg (keep top), else pop (||) */
+    };
+
+    struct instruction_t {
+        op_t     op;
+        uint32_t arg;
+    };
+
+    struct load_t {
+        data_type_t    data_type;
+        value_kind_t   kind;
+        const uint8_t *addr;
+    };
+
+    enum class type_t { boolean, numeric };
+
+    std::string                                        expression;
+    std::string                                        name_prefix;
+    std::vector<std::unique_ptr<cxxshm::SharedMemory>> shms;  // indexed by register_type_t
+    std::vector<instruction_t>                         code;
+    std::vector<double>                                constants;
+    std::vector<load_t>                                loads;
+    std::size_t                                        max_depth = 0;
+    mutable std::vector<double>                        stack;
+
+    // parser state
+    std::size_t pos   = 0;
+    std::size_t depth = 0;
+
+    [[noreturn]] void error(const std::string &what) const;
+    void              skip_space();
+    bool              accept(const char *token);
+
+    void emit(op_t op, uint32_t arg = 0);
+    void push();
+    void pop(std::size_t n = 1);
+
+    type_t parse_or();
+    type_t parse_and();
+    type_t parse_comparison();
+    type_t parse_sum();
+    type_t parse_product();
+    type_t parse_unary();
+    type_t parse_primary();
+    type_t parse_signal();
+
+    void expect(type_t actual, type_t expected, const char *context) const;
+};
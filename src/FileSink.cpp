@@ -0,0 +1,734 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "FileSink.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#if defined(OS_LINUX) && __has_include(<linux/io_uring.h>)
+#    define FILE_SINK_IO_URING
+#    include <linux/io_uring.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <sys/uio.h>
+#endif
+
+class FileSink::Backend {
+public:
+    virtual ~Backend() = default;
+
+    /**
+     * \brief append a buffer to the current file
+     *
+     * The backend sets busy[buffer] to false once the buffer can be reused.
+     */
+    virtual void write(std::size_t buffer, std::size_t size) = 0;
+
+    /**
+     * \brief subsequent writes go to a new file
+     */
+    virtual void rotate(const std::string &name) = 0;
+
+    /**
+     * \brief process completions (must not block)
+     */
+    virtual void poll() {}
+
+    /**
+     * \brief wait until all writes are completed and close all files
+     */
+    virtual void drain() = 0;
+
+    [[nodiscard]] virtual const char *name() const noexcept = 0;
+};
+
+/**
+ * \brief open an output file
+ * @param name file name
+ * @param truncate truncate the file (append otherwise)
+ * @param offset set to the offset of the first write
+ * @return file descriptor
+ */
+static int open_output(const std::string &name, bool truncate, uint64_t &offset) {
+    int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "failed to open '" + name + '\'');
+
+    struct stat st {};
+    if (fstat(fd, &st)) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "failed to stat '" + name + '\'');
+    }
+    offset = static_cast<uint64_t>(st.st_size);
+    return fd;
+}
+
+/**
+ * \brief backend that writes the buffers from a separate thread via pwrite
+ */
+class PwriteBackend final : public FileSink::Backend {
+private:
+    struct command_t {
+        std::size_t buffer;
+        std::size_t size;
+        std::string rotate_name;  // rotate if not empty
+    };
+
+    char              *buffers;
+    std::size_t        buffer_size;
+    std::atomic<bool> *busy;
+
+    int      fd;
+    uint64_t offset = 0;
+    bool     error  = false;
+
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::deque<command_t>   queue;
+    bool                    stop = false;
+    std::thread             thread;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            cv.wait(lock, [this] { return stop || !queue.empty(); });
+            if (queue.empty()) break;
+
+            auto command = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+
+            if (!command.rotate_name.empty()) {
+                if (fd >= 0) close(fd);
+                try {
+                    fd    = open_output(command.rotate_name, true, offset);
+                    error = false;
+                } catch (const std::system_error &e) {
+                    std::cerr << "WARNING: file sink: " << e.what() << std::endl;
+                    fd = -1;
+                }
+            } else {
+                write_buffer(buffers + command.buffer * buffer_size, command.size);
+                busy[command.buffer].store(false, std::memory_order_release);
+            }
+
+            lock.lock();
+        }
+    }
+
+    void write_buffer(const char *data, std::size_t size) {
+        if (fd < 0) return;
+
+        while (size) {
+            const auto ret = pwrite(fd, data, size, static_cast<off_t>(offset));
+            if (ret < 0) {
+                if (errno == EINTR) continue;
+                if (!error) std::cerr << "WARNING: file sink: write failed: " << strerror(errno) << std::endl;
+                error = true;
+                return;
+            }
+            data += ret;
+            size -= static_cast<std::size_t>(ret);
+            offset += static_cast<uint64_t>(ret);
+        }
+    }
+
+    void push(command_t command) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.emplace_back(std::move(command));
+        }
+        cv.notify_one();
+    }
+
+public:
+    PwriteBackend(const std::string &name,
+                  bool               truncate,
+                  char              *buffers,
+                  std::size_t        buffer_size,
+                  std::atomic<bool> *busy)
+        : buffers(buffers), buffer_size(buffer_size), busy(busy), fd(open_output(name, truncate, offset)) {
+        thread = std::thread(&PwriteBackend::run, this);
+    }
+
+    ~PwriteBackend() override { drain(); }
+
+    void write(std::size_t buffer, std::size_t size) override { push({buffer, size, std::string()}); }
+
+    void rotate(const std::string &name) override { push({0, 0, name}); }
+
+    void drain() override {
+        if (!thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_one();
+        thread.join();
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    [[nodiscard]] const char *name() const noexcept override { return "pwrite thread"; }
+};
+
+#ifdef FILE_SINK_IO_URING
+/**
+ * \brief backend that writes the buffers via io_uring
+ *
+ * All ring operations are done by the thread that uses the file sink. Completions are reaped without a system call.
+ * Opening and closing of files during rotation is done via io_uring as well.
+ */
+class IoUringBackend final : public FileSink::Backend {
+private:
+    enum op_t : uint64_t { OP_WRITE = 1, OP_OPEN = 2, OP_CLOSE = 3 };
+
+    static uint64_t user_data(op_t op, std::size_t slot, std::size_t buffer) {
+        return (static_cast<uint64_t>(op) << 56) | (slot << 32) | buffer;
+    }
+
+    struct file_t {
+        int                      fd      = -1;
+        bool                     used    = false;
+        bool                     opening = false;
+        bool                     retired = false;
+        uint64_t                 offset  = 0;  // offset of the next write
+        std::size_t              pending = 0;  // writes that are not completed
+        std::string              name;
+        std::vector<std::size_t> backlog;  // writes waiting for the file to be opened
+    };
+
+    struct write_t {
+        std::size_t slot;
+        uint64_t    offset;
+        std::size_t size;
+        std::size_t done;
+    };
+
+    char              *buffers;
+    std::size_t        buffer_size;
+    std::atomic<bool> *busy;
+
+    int           ring_fd = -1;
+    void         *ring    = MAP_FAILED;
+    std::size_t   ring_len;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    std::size_t   sqes_len;
+
+    unsigned     *sq_head;
+    unsigned     *sq_tail;
+    unsigned     *sq_mask;
+    unsigned     *sq_array;
+    unsigned      sq_entries;
+    unsigned     *cq_head;
+    unsigned     *cq_tail;
+    unsigned     *cq_mask;
+    io_uring_cqe *cqes;
+
+    std::vector<file_t>  files;
+    std::size_t          current_file = 0;
+    std::vector<write_t> writes;
+    std::size_t          ops_in_flight = 0;
+    bool                 error         = false;
+
+    io_uring_sqe *get_sqe() {
+        const unsigned tail = *sq_tail;
+        const unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head >= sq_entries) throw std::logic_error("io_uring submission queue full");
+
+        const unsigned index = tail & *sq_mask;
+        auto          *sqe   = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+        return sqe;
+    }
+
+    void submit_sqe() {
+        __atomic_store_n(sq_tail, *sq_tail + 1, __ATOMIC_RELEASE);
+        ++ops_in_flight;
+
+        for (;;) {
+            const auto ret = syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0);
+            if (ret >= 0) break;
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+        }
+    }
+
+    void submit_write(std::size_t buffer) {
+        const auto &write = writes[buffer];
+        auto       *sqe   = get_sqe();
+        sqe->opcode       = IORING_OP_WRITE_FIXED;
+        sqe->fd           = files[write.slot].fd;
+        sqe->off          = write.offset + write.done;
+        sqe->addr         = reinterpret_cast<uint64_t>(buffers + buffer * buffer_size + write.done);
+        sqe->len          = static_cast<uint32_t>(write.size - write.done);
+        sqe->buf_index    = static_cast<uint16_t>(buffer);
+        sqe->user_data    = user_data(OP_WRITE, write.slot, buffer);
+        submit_sqe();
+    }
+
+    void submit_open(std::size_t slot) {
+        auto *sqe       = get_sqe();
+        sqe->opcode     = IORING_OP_OPENAT;
+        sqe->fd         = AT_FDCWD;
+        sqe->addr       = reinterpret_cast<uint64_t>(files[slot].name.c_str());
+        sqe->len        = 0644;
+        sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        sqe->user_data  = user_data(OP_OPEN, slot, 0);
+        submit_sqe();
+    }
+
+    /** close a retired file once all of its writes are completed */
+    void close_if_done(std::size_t slot) {
+        auto &file = files[slot];
+        if (!file.retired || file.opening || file.pending) return;
+
+        if (file.fd < 0) {
+            file.used = false;
+            return;
+        }
+
+        auto *sqe      = get_sqe();
+        sqe->opcode    = IORING_OP_CLOSE;
+        sqe->fd        = file.fd;
+        sqe->user_data = user_data(OP_CLOSE, slot, 0);
+        file.retired   = false;  // close is in flight
+        submit_sqe();
+    }
+
+    void release(std::size_t buffer) {
+        auto &file = files[writes[buffer].slot];
+        --file.pending;
+        busy[buffer].store(false, std::memory_order_release);
+        close_if_done(writes[buffer].slot);
+    }
+
+    void report(const char *what, int err) {
+        if (!error) std::cerr << "WARNING: file sink: " << what << ": " << strerror(err) << std::endl;
+        error = true;
+    }
+
+    void complete(uint64_t data, int res) {
+        const auto op     = static_cast<op_t>(data >> 56);
+        const auto slot   = (data >> 32) & 0xFFFFFF;
+        const auto buffer = data & 0xFFFFFFFF;
+        auto      &file   = files[slot];
+
+        switch (op) {
+            case OP_WRITE: {
+                auto &write = writes[buffer];
+                if (res == -EINTR || res == -EAGAIN) {
+                    submit_write(buffer);
+                } else if (res < 0) {
+                    report("write failed", -res);
+                    release(buffer);
+                } else {
+                    write.done += static_cast<std::size_t>(res);
+                    if (write.done < write.size && res > 0) submit_write(buffer);
+                    else
+                        release(buffer);
+                }
+                break;
+            }
+            case OP_OPEN: {
+                file.opening = false;
+                if (res == -EINVAL || res == -EOPNOTSUPP) {
+                    // operation not supported by kernel
+                    uint64_t offset;
+                    try {
+                        file.fd = open_output(file.name, true, offset);
+                    } catch (const std::system_error &e) { report(e.what(), e.code().value()); }
+                } else if (res < 0) {
+                    report(("failed to open '" + file.name + '\'').c_str(), -res);
+                } else {
+                    file.fd = res;
+                }
+
+                for (auto b : file.backlog) {
+                    if (file.fd >= 0) submit_write(b);
+                    else
+                        release(b);
+                }
+                file.backlog.clear();
+                close_if_done(slot);
+                break;
+            }
+            case OP_CLOSE: {
+                if (res == -EINVAL || res == -EOPNOTSUPP) close(file.fd);
+                file.fd   = -1;
+                file.used = false;
+                break;
+            }
+            default: throw std::logic_error("unexpected io_uring completion");
+        }
+    }
+
+    void wait_completion() {
+        for (;;) {
+            const auto ret = syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret >= 0) break;
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+        }
+        poll();
+    }
+
+public:
+    IoUringBackend(const std::string &name,
+                   bool               truncate,
+                   char              *buffers,
+                   std::size_t        buffer_size,
+                   std::size_t        buffer_count,
+                   std::atomic<bool> *busy)
+        : buffers(buffers),
+          buffer_size(buffer_size),
+          busy(busy),
+          files(buffer_count + 2),
+          writes(buffer_count) {
+        if (buffer_count > 0xFFFF) throw std::invalid_argument("too many buffers");
+
+        // each buffer can be in flight and each file can be opened/closed at the same time
+        const auto     entries = static_cast<unsigned>(buffer_count + 2 * files.size());
+        io_uring_params params {};
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_fd < 0) throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+
+        try {
+            if (!(params.features & IORING_FEAT_SINGLE_MMAP)) throw std::runtime_error("kernel too old");
+
+            ring_len = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+            ring     = mmap(nullptr,
+                        ring_len,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE,
+                        ring_fd,
+                        IORING_OFF_SQ_RING);
+            if (ring == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap io_uring");
+
+            sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+            sqes     = static_cast<io_uring_sqe *>(mmap(nullptr,
+                                                    sqes_len,
+                                                    PROT_READ | PROT_WRITE,
+                                                    MAP_SHARED | MAP_POPULATE,
+                                                    ring_fd,
+                                                    IORING_OFF_SQES));
+            if (sqes == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap io_uring sqes");
+
+            auto *base = static_cast<char *>(ring);
+            sq_head    = reinterpret_cast<unsigned *>(base + params.sq_off.head);
+            sq_tail    = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+            sq_mask    = reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+            sq_array   = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+            sq_entries = params.sq_entries;
+            cq_head    = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+            cq_tail    = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+            cq_mask    = reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+            cqes       = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+
+            std::vector<iovec> iovecs(buffer_count);
+            for (std::size_t i = 0; i < buffer_count; ++i) {
+                iovecs[i].iov_base = buffers + i * buffer_size;
+                iovecs[i].iov_len  = buffer_size;
+            }
+            if (syscall(__NR_io_uring_register,
+                        ring_fd,
+                        IORING_REGISTER_BUFFERS,
+                        iovecs.data(),
+                        static_cast<unsigned>(iovecs.size())))
+                throw std::system_error(errno, std::generic_category(), "failed to register buffers");
+
+            for (auto &file : files)
+                file.backlog.reserve(buffer_count);
+
+            auto &file = files[current_file];
+            file.fd    = open_output(name, truncate, file.offset);
+            file.used  = true;
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    ~IoUringBackend() override {
+        try {
+            drain();
+        } catch (const std::exception &e) { std::cerr << "WARNING: file sink: " << e.what() << std::endl; }
+        unmap();
+    }
+
+    void write(std::size_t buffer, std::size_t size) override {
+        auto &file     = files[current_file];
+        writes[buffer] = {current_file, file.offset, size, 0};
+        file.offset += size;
+        ++file.pending;
+
+        if (file.opening) file.backlog.push_back(buffer);
+        else if (file.fd >= 0)
+            submit_write(buffer);
+        else
+            release(buffer);
+    }
+
+    void rotate(const std::string &name) override {
+        const auto old = current_file;
+
+        auto free_slot = [this]() {
+            return std::find_if(files.begin(), files.end(), [](const file_t &f) { return !f.used; });
+        };
+        auto slot = free_slot();
+        while (slot == files.end()) {
+            // only possible if a lot of rotations are waiting for the storage
+            wait_completion();
+            slot = free_slot();
+        }
+
+        current_file  = static_cast<std::size_t>(slot - files.begin());
+        slot->used    = true;
+        slot->opening = true;
+        slot->retired = false;
+        slot->offset  = 0;
+        slot->pending = 0;
+        slot->fd      = -1;
+        slot->name    = name;
+        submit_open(current_file);
+
+        files[old].retired = true;
+        close_if_done(old);
+    }
+
+    void poll() override {
+        unsigned       head = *cq_head;
+        const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            const auto &cqe  = cqes[head & *cq_mask];
+            const auto  data = cqe.user_data;
+            const auto  res  = cqe.res;
+            ++head;
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            --ops_in_flight;
+            complete(data, res);
+        }
+    }
+
+    void drain() override {
+        if (ring_fd < 0) return;
+
+        if (files[current_file].used && !files[current_file].retired) {
+            files[current_file].retired = true;
+            close_if_done(current_file);
+        }
+
+        while (ops_in_flight)
+            wait_completion();
+    }
+
+    [[nodiscard]] const char *name() const noexcept override { return "io_uring"; }
+
+private:
+    void unmap() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_len);
+        if (ring != MAP_FAILED) munmap(ring, ring_len);
+        if (ring_fd >= 0) close(ring_fd);
+        sqes    = static_cast<io_uring_sqe *>(MAP_FAILED);
+        ring    = MAP_FAILED;
+        ring_fd = -1;
+    }
+};
+#endif
+
+FileSink::FileSink(std::string               path,
+                   std::size_t               rotate_size,
+                   std::chrono::milliseconds rotate_time,
+                   std::size_t               buffer_size,
+                   std::size_t               buffer_count)
+    : path(std::move(path)),
+      rotate_size(rotate_size),
+      rotate_time(rotate_time),
+      buffer_size(buffer_size),
+      buffer_count(buffer_count),
+      buffers(new char[(buffer_count + 1) * buffer_size]),
+      busy(new std::atomic<bool>[buffer_count]),
+      segment_start(std::chrono::steady_clock::now()) {
+    if (buffer_size == 0 || buffer_count == 0) throw std::invalid_argument("invalid file sink buffer configuration");
+
+    for (std::size_t i = 0; i < buffer_count; ++i)
+        busy[i].store(false);
+
+    const auto name = rotation_enabled() ? segment_name() : this->path;
+
+#ifdef FILE_SINK_IO_URING
+    try {
+        backend = std::make_unique<IoUringBackend>(
+                name, rotation_enabled(), buffers.get(), buffer_size, buffer_count, busy.get());
+    } catch (const std::exception &e) {
+        std::cerr << "file sink: io_uring not available (" << e.what() << "), using pwrite thread" << std::endl;
+    }
+#endif
+    if (!backend)
+        backend = std::make_unique<PwriteBackend>(name, rotation_enabled(), buffers.get(), buffer_size, busy.get());
+
+    setp(buffer(0), buffer(0) + buffer_size);
+}
+
+FileSink::~FileSink() {
+    if (pptr() != pbase() || !cycle_buffers.empty() || current == buffer_count) submit();
+    backend->drain();
+    if (dropped_bytes)
+        std::cerr << "WARNING: file sink: " << dropped_bytes << " bytes (" << dropped_cycles << " cycles) dropped"
+                  << std::endl;
+}
+
+const char *FileSink::backend_name() const noexcept {
+    return backend->name();
+}
+
+bool FileSink::rotation_enabled() const noexcept {
+    return rotate_size != 0 || rotate_time.count() != 0;
+}
+
+std::string FileSink::segment_name() const {
+    auto ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                            std::chrono::system_clock::now().time_since_epoch())
+                                            .count());
+    // file names must be unique
+    ms              = std::max(ms, last_segment_ms + 1);
+    last_segment_ms = ms;
+
+    return path + '.' + std::to_string(ms);
+}
+
+void FileSink::acquire() {
+    backend->poll();
+    const auto prev = current == buffer_count ? 0 : current + 1;
+    current         = buffer_count;
+    for (std::size_t i = 0; i < buffer_count; ++i) {
+        const auto candidate = (prev + i) % buffer_count;
+        if (!busy[candidate].load(std::memory_order_acquire)) {
+            current = candidate;
+            break;
+        }
+    }
+
+    if (current == buffer_count) {
+        // no free buffer: the cycle is dropped completely, including the buffers it already filled
+        cycle_dropped_bytes += cycle_buffers.size() * buffer_size;
+        for (const auto index : cycle_buffers)
+            busy[index].store(false, std::memory_order_relaxed);
+        cycle_buffers.clear();
+    }
+
+    setp(buffer(current), buffer(current) + buffer_size);
+}
+
+void FileSink::next_buffer() {
+    if (current == buffer_count) {
+        // dropping: reuse the scratch buffer
+        cycle_dropped_bytes += static_cast<std::size_t>(pptr() - pbase());
+        setp(pbase(), epptr());
+        return;
+    }
+
+    busy[current].store(true, std::memory_order_relaxed);
+    cycle_buffers.push_back(current);
+    acquire();
+}
+
+void FileSink::submit() {
+    const auto size = static_cast<std::size_t>(pptr() - pbase());
+
+    if (current == buffer_count) {
+        cycle_dropped_bytes += size;
+    } else {
+        for (const auto index : cycle_buffers)
+            backend->write(index, buffer_size);
+        segment_bytes += cycle_buffers.size() * buffer_size;
+        cycle_buffers.clear();
+
+        if (size) {
+            busy[current].store(true, std::memory_order_relaxed);
+            backend->write(current, size);
+            segment_bytes += size;
+        }
+    }
+
+    if (cycle_dropped_bytes) {
+        if (!dropped) std::cerr << "WARNING: file sink: all buffers in flight, dropping output" << std::endl;
+        dropped_bytes += cycle_dropped_bytes;
+        ++dropped_cycles;
+        cycle_dropped_bytes = 0;
+        dropped             = true;
+    } else if (dropped) {
+        std::cerr << "file sink: output resumed (" << dropped_bytes << " bytes dropped so far)" << std::endl;
+        dropped = false;
+    }
+
+    // the current buffer is kept if the cycle did not write to it
+    if (current == buffer_count || size) acquire();
+    else
+        backend->poll();
+}
+
+void FileSink::rotate_if_required() {
+    if (!rotation_enabled()) return;
+
+    const auto now = std::chrono::steady_clock::now();
+    if ((rotate_size && segment_bytes >= rotate_size) || (rotate_time.count() && now - segment_start >= rotate_time)) {
+        backend->rotate(segment_name());
+        segment_bytes = 0;
+        segment_start = now;
+    }
+}
+
+FileSink::int_type FileSink::overflow(int_type ch) {
+    next_buffer();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize FileSink::xsputn(const char *s, std::streamsize n) {
+    auto remaining = n;
+    while (remaining > 0) {
+        const auto space = epptr() - pptr();
+        if (space == 0) {
+            next_buffer();
+            continue;
+        }
+
+        const auto chunk = std::min<std::streamsize>(space, remaining);
+        memcpy(pptr(), s, static_cast<std::size_t>(chunk));
+        pbump(static_cast<int>(chunk));
+        s += chunk;
+        remaining -= chunk;
+    }
+    return n;
+}
+
+int FileSink::sync() {
+    if (pptr() != pbase() || !cycle_buffers.empty() || current == buffer_count) {
+        submit();
+        rotate_if_required();
+    } else {
+        backend->poll();
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/**
+ * \brief stream buffer that writes to a file without blocking the caller
+ *
+ * Output is collected in a fixed pool of buffers. The buffers of a cycle are handed to the backend on sync() (e.g.
+ * std::flush at the end of a cycle), so the file contains only complete cycles. The backend writes the buffers
+ * asynchronously via io_uring (registered buffers). If io_uring is not available, a thread that writes the buffers
+ * via pwrite is used instead.
+ *
+ * If all buffers are still in flight, the output is dropped (and reported on stderr) instead of stalling the caller.
+ * Output is always dropped in complete cycles: if no buffer is free in the middle of a cycle, the buffers that were
+ * already filled by the cycle are discarded as well. A cycle must therefore fit into buffer_size * buffer_count bytes.
+ *
+ * If rotation is enabled, the output is written to files named <path>.<unix time in ms>. A new file is started at the
+ * next sync() after rotate_size bytes were written to the current file or rotate_time has elapsed.
+ */
+class FileSink final : public std::streambuf {
+public:
+    class Backend;
+
+    /**
+     * \brief create file sink
+     * @param path output file (or file name prefix if rotation is enabled)
+     * @param rotate_size rotate after this number of bytes (0: disabled)
+     * @param rotate_time rotate after this time (0: disabled)
+     * @param buffer_size size of one buffer
+     * @param buffer_count number of buffers
+     */
+    FileSink(std::string               path,
+             std::size_t               rotate_size,
+             std::chrono::milliseconds rotate_time,
+             std::size_t               buffer_size  = 256 * 1024,
+             std::size_t               buffer_count = 16);
+
+    ~FileSink() override;
+
+    FileSink(const FileSink &)            = delete;
+    FileSink &operator=(const FileSink &) = delete;
+
+    /**
+     * \brief get name of the backend that is used
+     */
+    [[nodiscard]] const char *backend_name() const noexcept;
+
+protected:
+    int_type        overflow(int_type ch) override;
+    std::streamsize xsputn(const char *s, std::streamsize n) override;
+    int             sync() override;
+
+private:
+    std::string                           path;
+    std::size_t                           rotate_size;
+    std::chrono::steady_clock::duration   rotate_time;
+    std::size_t                           buffer_size;
+    std::size_t                           buffer_count;
+    std::unique_ptr<char[]>               buffers;  // buffer_count buffers + one scratch buffer used while dropping
+    std::unique_ptr<std::atomic<bool>[]>  busy;     // in flight or filled by the current cycle
+    std::size_t                           current = 0;
+    std::vector<std::size_t>              cycle_buffers;  // full buffers of the current cycle (not yet submitted)
+    std::unique_ptr<Backend>              backend;
+    std::size_t                           segment_bytes = 0;
+    std::chrono::steady_clock::time_point segment_start;
+    std::size_t                           cycle_dropped_bytes = 0;  // dropped bytes of the current cycle
+    std::size_t                           dropped_bytes       = 0;
+    std::size_t                           dropped_cycles      = 0;
+    bool                                  dropped             = false;  // the previous cycle was dropped
+    mutable uint64_t                      last_segment_ms     = 0;
+
+    [[nodiscard]] bool rotation_enabled() const noexcept;
+    [[nodiscard]] char *buffer(std::size_t index) const noexcept { return buffers.get() + index * buffer_size; }
+
+    [[nodiscard]] std::string segment_name() const;
+
+    /** switch to a free buffer (or start dropping the cycle if there is none) */
+    void acquire();
+    /** the current buffer is full: keep it for the end of the cycle and switch to the next one */
+    void next_buffer();
+    /** end of a cycle: hand the buffers of the cycle to the backend */
+    void submit();
+    void rotate_if_required();
+};
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "InfluxFormat.hpp"
+
+#include "format.hpp"
+#include "split_string.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+/**
+ * \brief escape the special characters of the line protocol with a backslash
+ * @param str string to escape
+ * @param special characters to escape
+ */
+static std::string escape(const std::string &str, const char *special) {
+    std::string result;
+    result.reserve(str.size());
+    for (const char c : str) {
+        if (c == '\n' || c == '\r') throw std::invalid_argument("line breaks are not allowed in line protocol names");
+        if (strchr(special, c)) result += '\\';
+        result += c;
+    }
+    return result;
+}
+
+static constexpr const char MEASUREMENT_SPECIAL[] = ", ";
+static constexpr const char KEY_SPECIAL[]         = ",= ";
+
+std::vector<std::pair<std::string, std::string>> InfluxFormat::parse_tags(const std::string &tags) {
+    std::vector<std::pair<std::string, std::string>> result;
+    if (tags.empty()) return result;
+
+    for (const auto &tag : split_string(tags, ',')) {
+        const auto separator = tag.find('=');
+        if (separator == std::string::npos || separator == 0 || separator == tag.size() - 1)
+            throw std::invalid_argument("invalid tag '" + tag + "' (expected: key=value)");
+        result.emplace_back(tag.substr(0, separator), tag.substr(separator + 1));
+    }
+    return result;
+}
+
+InfluxFormat::InfluxFormat(const std::string &measurement, const std::string &tags)
+    : default_measurement(measurement), default_tags(parse_tags(tags)) {
+    if (measurement.empty()) throw std::invalid_argument("measurement name must not be empty");
+}
+
+void InfluxFormat::add_signal(const std::string &field, const std::string &measurement, const std::string &tags) {
+    // signal tags override default tags; tags are sorted by key (recommended by InfluxDB)
+    auto all_tags = default_tags;
+    for (auto &tag : parse_tags(tags)) {
+        auto existing = std::find_if(
+                all_tags.begin(), all_tags.end(), [&tag](const auto &other) { return other.first == tag.first; });
+        if (existing != all_tags.end()) existing->second = std::move(tag.second);
+        else
+            all_tags.push_back(std::move(tag));
+    }
+    std::sort(all_tags.begin(), all_tags.end());
+
+    std::string key = escape(measurement.empty() ? default_measurement : measurement, MEASUREMENT_SPECIAL);
+    for (const auto &[tag_key, tag_value] : all_tags) {
+        key += ',';
+        key += escape(tag_key, KEY_SPECIAL);
+        key += '=';
+        key += escape(tag_value, KEY_SPECIAL);
+    }
+
+    auto index = series_index.find(key);
+    if (index == series_index.end()) {
+        index = series_index.emplace(key, series.size()).first;
+        series.push_back(key);
+    }
+    signal_series.push_back(index->second);
+    fields.push_back(escape(field, KEY_SPECIAL) + '=');
+
+    // line per signal: series, separator, field, value, time stamp (" " + 20 digits + "\n")
+    output_size += key.size() + 1 + fields.back().size() + MAX_VALUE_CHARS + 22;
+}
+
+void InfluxFormat::set_timestamp(int64_t timestamp_ns) {
+    char  buffer[MAX_VALUE_CHARS];
+    char *end = format::dec(buffer, timestamp_ns);
+    timestamp.assign(1, ' ');
+    timestamp.append(buffer, end);
+    timestamp += '\n';
+}
+
+void InfluxFormat::append(std::string &buffer,
+                          line_t      &line,
+                          std::size_t  signal,
+                          const char  *value,
+                          std::size_t  size) const {
+    const auto signal_series_index = signal_series[signal];
+    if (line.series == signal_series_index) {
+        buffer += ',';
+    } else {
+        finish(buffer, line);
+        buffer += series[signal_series_index];
+        buffer += ' ';
+        line.series = signal_series_index;
+    }
+
+    buffer += fields[signal];
+    buffer.append(value, size);
+}
+
+void InfluxFormat::finish(std::string &buffer, line_t &line) const {
+    if (line.series == std::numeric_limits<std::size_t>::max()) return;
+    buffer += timestamp;
+    line.series = std::numeric_limits<std::size_t>::max();
+}
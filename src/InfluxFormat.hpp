@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \brief output in the InfluxDB line protocol
+ *
+ * Each signal is a field of a series (measurement and tag set). The series keys and field keys are escaped and
+ * rendered once when the signals are added. Consecutive signals of the same series are written as one line; all
+ * lines of a cycle have the same time stamp (ns).
+ *
+ * Example: "modbus,site=plant1 ao:2:f32l=1.5,do:3=true 1700000000000000000"
+ */
+class InfluxFormat {
+public:
+    /** state of the current line of an output buffer */
+    struct line_t {
+        std::size_t series = std::numeric_limits<std::size_t>::max();  // series of the open line
+    };
+
+    /**
+     * \brief create formatter
+     * @param measurement default measurement
+     * @param tags default tags (comma separated key=value pairs, may be empty)
+     */
+    InfluxFormat(const std::string &measurement, const std::string &tags);
+
+    /**
+     * \brief add a signal (signals are identified by the order in which they are added)
+     * @param field field key
+     * @param measurement measurement (empty: default measurement)
+     * @param tags additional tags (override default tags with the same key)
+     */
+    void add_signal(const std::string &field, const std::string &measurement, const std::string &tags);
+
+    /** \brief set the time stamp of the following lines */
+    void set_timestamp(int64_t timestamp_ns);
+
+    /**
+     * \brief append a field to a buffer
+     * @param buffer output buffer
+     * @param line line state of the buffer
+     * @param signal signal index
+     * @param value formatted field value
+     * @param size length of the value
+     */
+    void append(std::string &buffer, line_t &line, std::size_t signal, const char *value, std::size_t size) const;
+
+    /** \brief terminate the open line of a buffer */
+    void finish(std::string &buffer, line_t &line) const;
+
+    /** \brief maximum output size if each signal is output once */
+    [[nodiscard]] std::size_t max_output() const noexcept { return output_size; }
+
+    /**
+     * \brief parse a tag list
+     * @param tags comma separated key=value pairs
+     * @return unescaped tags
+     */
+    static std::vector<std::pair<std::string, std::string>> parse_tags(const std::string &tags);
+
+private:
+    std::string                                      default_measurement;
+    std::vector<std::pair<std::string, std::string>> default_tags;
+
+    std::vector<std::string>                     series;  // escaped "measurement,tag=value,..."
+    std::unordered_map<std::string, std::size_t> series_index;
+    std::vector<std::size_t>                     signal_series;
+    std::vector<std::string>                     fields;  // escaped "field="
+
+    std::string timestamp;  // " <ns>\n"
+    std::size_t output_size = 0;
+};
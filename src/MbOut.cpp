@@ -5,52 +5,32 @@
 
 #include "MbOut.hpp"
 
+#include "realtime.hpp"
 #include "split_string.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
-#include <cxxendian.hpp>
+#include <cstring>
+#include <ctime>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
-#include <limits>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 
-union r16 {
-    uint16_t reg;
-    uint16_t u_data;
-    int16_t  i_data;
-    uint8_t  ub[2];
-    int8_t   ib[2];
-    r16(uint16_t data) : u_data(data) {}  // NOLINT
-    r16() = default;
-};
-
-union r32 {
-    uint32_t u_data;
-    int32_t  i_data;
-    float    f_data;
-    uint16_t reg[2];
-    r32(uint32_t data) : u_data(data) {}  // NOLINT
-    r32() = default;
-};
-
-union r64 {
-    uint64_t u_data;
-    int64_t  i_data;
-    double   f_data;
-    uint16_t reg[4];
-    r64(uint64_t data) : u_data(data) {}  // NOLINT
-    r64() = default;
-};
-
-MbOut::MbOut(const std::string &path, std::ostream &out, const std::string &name_prefix)
+MbOut::MbOut(const std::string &path,
+             std::ostream      &out,
+             const std::string &name_prefix,
+             float_format_t     float_format)
     : modbus_do(name_prefix + "DO"),
       modbus_di(name_prefix + "DI"),
       modbus_ao(name_prefix + "AO"),
       modbus_ai(name_prefix + "AI"),
-      out(out) {
+      out(out),
+      default_float_format(float_format) {
+    groups.push_back({0, 0, 0});
+
     int line_number;
 
     if (path.empty() || path == "-") {
@@ -82,6 +62,49 @@ MbOut::MbOut(const std::string &path, std::ostream &out, const std::string &name
 
         if (infile.bad()) throw std::runtime_error("failed to read file");
     }
+
+    // remove empty groups (but keep at least one)
+    groups.erase(std::remove_if(groups.begin(),
+                                groups.end(),
+                                [](const signal_group_t &group) { return group.count == 0; }),
+                 groups.end());
+    if (groups.empty()) groups.push_back({0, 0, 0});
+
+    // one batch decoder per group: groups with individual cycle times are decoded independently
+    values.resize(signals.size());
+    decoders.resize(groups.size());
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        auto &group = groups[g];
+        for (auto i = group.first; i < group.first + group.count; ++i)
+            decoders[g].add(signals[i].data_type, signal_addr(signals[i]), i);
+
+        scaled_range(group.first, group.count, group.first_scaled, group.scaled_count);
+    }
+}
+
+void MbOut::scaled_range(std::size_t  first,
+                         std::size_t  count,
+                         std::size_t &first_scaled,
+                         std::size_t &scaled_count) const {
+    const auto begin = std::lower_bound(scaled_signals.begin(), scaled_signals.end(), first);
+    const auto end   = std::lower_bound(begin, scaled_signals.end(), first + count);
+    first_scaled     = static_cast<std::size_t>(begin - scaled_signals.begin());
+    scaled_count     = static_cast<std::size_t>(end - begin);
+}
+
+/**
+ * \brief parse the value of a numeric signal attribute
+ */
+static double parse_attribute_value(const std::string &key, const std::string &value) {
+    double      result;
+    std::size_t idx = 0;
+    try {
+        result = std::stod(value, &idx);
+    } catch (const std::exception &) { idx = 0; }
+
+    if (idx == 0 || idx != value.size() || std::isnan(result))
+        throw std::runtime_error("invalid value for signal attribute '" + key + '\'');
+    return result;
 }
 
 void MbOut::parse_config(const std::string &line) {
@@ -90,13 +113,18 @@ void MbOut::parse_config(const std::string &line) {
     const auto split_comment = split_string(line, '#', 1);
     if (split_comment.empty()) return;
 
+    if (split_comment[0][0] == '@') {
+        parse_directive(split_comment[0]);
+        return;
+    }
+
     const auto split_line = split_string(split_comment[0], ':');
 
-    if (split_line.size() != 2 && split_line.size() != 3) { throw std::runtime_error("to few separators"); }
+    if (split_line.size() < 2) { throw std::runtime_error("to few separators"); }
 
     const auto  reg_type  = str_to_register_type(split_line[0]);
     const auto &index_str = split_line[1];
-    const auto  data_type = split_line.size() == 3 ? str_to_data_type(split_line[2]) : data_type_t::bit;
+    const auto  data_type = split_line.size() >= 3 ? str_to_data_type(split_line[2]) : data_type_t::bit;
 
     unsigned long long base_index;
     bool               fail = false;
@@ -109,11 +137,49 @@ void MbOut::parse_config(const std::string &line) {
     if (fail) throw std::runtime_error("invalid register index format");
 
     signals.emplace_back(data_type, reg_type, base_index);
+    auto &signal        = signals.back();
+    signal.float_format = default_float_format;
+
+    // optional signal attributes (key=value)
+    Scaling::parameters_t scaling_parameters;
+    bool                  scaled = false;
+    for (std::size_t i = 3; i < split_line.size(); ++i) {
+        const auto attribute = split_string(split_line[i], '=', 1);
+        if (attribute.size() != 2) throw std::runtime_error("invalid signal attribute '" + split_line[i] + '\'');
+
+        const auto &key   = attribute[0];
+        const auto &value = attribute[1];
+        if (key == "fmt") {
+            signal.float_format = str_to_float_format(value);
+        } else if (key == "measurement") {
+            if (value.empty()) throw std::runtime_error("measurement name must not be empty");
+            influx_attributes[signals.size() - 1].measurement = value;
+        } else if (key == "tags") {
+            InfluxFormat::parse_tags(value);  // check syntax
+            influx_attributes[signals.size() - 1].tags = value;
+        } else if (key == "field") {
+            if (value.empty()) throw std::runtime_error("field key must not be empty");
+            influx_attributes[signals.size() - 1].field = value;
+        } else if (key == "scale") {
+            scaling_parameters.scale = parse_attribute_value(key, value);
+            scaled                   = true;
+        } else if (key == "offset") {
+            scaling_parameters.offset = parse_attribute_value(key, value);
+            scaled                    = true;
+        } else if (key == "min") {
+            scaling_parameters.min = parse_attribute_value(key, value);
+            scaled                 = true;
+        } else if (key == "max") {
+            scaling_parameters.max = parse_attribute_value(key, value);
+            scaled                 = true;
+        } else {
+            throw std::runtime_error("unknown signal attribute '" + key + '\'');
+        }
+    }
 
     // check signal
 
     // check data type
-    const auto &signal = signals.back();
     if (signal.data_type == data_type_t::bit) {
         if (signal.register_type == register_type_t::AI || signal.register_type == register_type_t::AO)
             throw std::runtime_error("data type invalid for specified register type");
@@ -125,297 +191,239 @@ void MbOut::parse_config(const std::string &line) {
     // check size
     auto min_size = (base_index + data_type_registers(signal.data_type)) * register_bytes(signal.register_type);
 
-    cxxshm::SharedMemory *mem;
-    switch (signal.register_type) {
-        case register_type_t::DO: mem = &modbus_do; break;
-        case register_type_t::DI: mem = &modbus_di; break;
-        case register_type_t::AO: mem = &modbus_ao; break;
-        case register_type_t::AI: mem = &modbus_ai; break;
+    if (shm(signal.register_type).get_size() < min_size) throw std::runtime_error("register index out of range");
+
+    // check scaling
+    if (scaled) {
+        if (signal.data_type == data_type_t::bit) throw std::runtime_error("coils can not be scaled");
+        if (!std::isfinite(scaling_parameters.scale) || !std::isfinite(scaling_parameters.offset))
+            throw std::runtime_error("scale and offset must be finite");
+        if (scaling_parameters.min > scaling_parameters.max) throw std::runtime_error("min is greater than max");
+
+        signal.scaling = scaling.add(scaling_parameters);
+        scaled_signals.push_back(signals.size() - 1);
+    }
+
+    ++groups.back().count;
+}
+
+void MbOut::parse_directive(const std::string &directive) {
+    std::istringstream stream(directive);
+    std::string        name;
+    stream >> name;
+
+    if (name == "@cycle") {
+        std::size_t cycle_ms = 0;
+        std::string rest;
+        if (!(stream >> cycle_ms) || cycle_ms == 0 || (stream >> rest))
+            throw std::runtime_error("invalid cycle time (expected: @cycle <milliseconds>)");
+        groups.push_back({cycle_ms, signals.size(), 0});
+    } else {
+        throw std::runtime_error("unknown directive '" + name + '\'');
     }
+}
 
-    if (mem->get_size() < min_size) throw std::runtime_error("register index out of range");
+cxxshm::SharedMemory &MbOut::shm(register_type_t register_type) {
+    switch (register_type) {
+        case register_type_t::DO: return modbus_do;
+        case register_type_t::DI: return modbus_di;
+        case register_type_t::AO: return modbus_ao;
+        case register_type_t::AI: return modbus_ai;
+        default: throw std::logic_error("unknown register type");
+    }
 }
 
-void MbOut::output_signal(const MbOut::signal_t &signal) {
-    out << std::dec;
+const uint8_t *MbOut::signal_addr(const signal_t &signal) {
+    return shm(signal.register_type).get_addr<const uint8_t *>() +
+           signal.base_index * register_bytes(signal.register_type);
+}
 
-    cxxshm::SharedMemory *mem;
+char *MbOut::format_name(char *dst, const signal_t &signal) {
     switch (signal.register_type) {
-        case register_type_t::DO:
-            mem = &modbus_do;
-            out << "do:";
-            break;
-        case register_type_t::DI:
-            mem = &modbus_di;
-            out << "di:";
-            break;
-        case register_type_t::AO:
-            mem = &modbus_ao;
-            out << "ao:";
-            break;
-        case register_type_t::AI:
-            mem = &modbus_ai;
-            out << "ai:";
-            break;
+        case register_type_t::DO: memcpy(dst, "do:", 3); break;
+        case register_type_t::DI: memcpy(dst, "di:", 3); break;
+        case register_type_t::AO: memcpy(dst, "ao:", 3); break;
+        case register_type_t::AI: memcpy(dst, "ai:", 3); break;
         default: throw std::logic_error("unknown register type");
     }
+    dst += 3;
 
-    out << signal.base_index << ':';
+    dst = format::dec(dst, static_cast<uint64_t>(signal.base_index));
 
+    if (signal.data_type != data_type_t::bit) {
+        const char *label     = data_type_label(signal.data_type);
+        const auto  label_len = strlen(label);
+        *dst++                = ':';
+        memcpy(dst, label, label_len);
+        dst += label_len;
+    }
+    return dst;
+}
+
+char *MbOut::format_signal(char *dst, const signal_t &signal, value_t value) {
+    dst    = format_name(dst, signal);
+    *dst++ = ':';
+    dst    = format_value(dst, signal, value);
+    *dst++ = '\n';
+    return dst;
+}
+
+char *MbOut::format_influx_value(char *dst, const signal_t &signal, value_t value) {
     if (signal.data_type == data_type_t::bit) {
-        out << (mem->at<uint8_t>(signal.base_index) ? '1' : '0') << std::endl;
+        const char *str = value.u ? "true" : "false";
+        const auto  len = strlen(str);
+        memcpy(dst, str, len);
+        return dst + len;
+    }
+
+    switch (value_kind(signal)) {
+        case value_kind_t::float32:
+            if (!std::isfinite(value.f32)) return nullptr;
+            return format::flt(dst, value.f32, signal.float_format);
+        case value_kind_t::float64:
+            if (!std::isfinite(value.f64)) return nullptr;
+            return format::flt(dst, value.f64, signal.float_format);
+        case value_kind_t::signed_int:
+            dst    = format::dec(dst, value.i);
+            *dst++ = 'i';
+            return dst;
+        case value_kind_t::unsigned_int:
+        case value_kind_t::hex:
+            // 64 bit values do not fit into the signed integer type of InfluxDB
+            dst    = format::dec(dst, value.u);
+            *dst++ = data_type_registers(signal.data_type) == 4 ? 'u' : 'i';
+            return dst;
+        default: throw std::logic_error("unknown value kind");
+    }
+}
+
+char *MbOut::format_value(char *dst, const signal_t &signal, value_t value) {
+    if (signal.scaled()) return format::flt(dst, value.f64, signal.float_format);
+    return format::value(dst, signal.data_type, value, signal.float_format);
+}
+
+value_kind_t MbOut::value_kind(const signal_t &signal) {
+    return signal.scaled() ? value_kind_t::float64 : data_type_value_kind(signal.data_type);
+}
+
+value_t MbOut::decode_signal(const signal_t &signal, const void *addr) const {
+    auto value = decode_value(signal.data_type, addr);
+    if (signal.scaled()) {
+        const auto raw = value_to_double(data_type_value_kind(signal.data_type), value);
+        value.f64      = scaling.apply(signal.scaling, raw);
+    }
+    return value;
+}
+
+void MbOut::decode_signals() {
+    for (std::size_t group = 0; group < groups.size(); ++group)
+        decode_signals(group);
+}
+
+void MbOut::decode_signals(std::size_t group_index) {
+    const auto &group = groups[group_index];
+    decoders[group_index].decode(values.data());
+    scale_signals(group.first_scaled, group.scaled_count);
+}
+
+void MbOut::scale_signals(std::size_t first, std::size_t count) {
+    if (count == 0) return;
+
+    // the raw values of the scaled signals (different data types) are collected and scaled in one pass
+    const auto last = first + count;
+    auto      *raw  = scaling.raw();
+    for (auto k = first; k < last; ++k) {
+        const auto i = scaled_signals[k];
+        raw[k]       = value_to_double(data_type_value_kind(signals[i].data_type), values[i]);
+    }
+    scaling.evaluate(first, count);
+    for (auto k = first; k < last; ++k)
+        values[scaled_signals[k]].f64 = scaling.value(k);
+}
+
+void MbOut::output_signal(std::size_t index) {
+    append_signal(out_buffer, influx_line, index, values[index]);
+}
+
+void MbOut::append_signal(std::string &buffer, InfluxFormat::line_t &line, std::size_t index, value_t value) const {
+    const auto &signal = signals[index];
+    if (influx) {
+        char  field_value[MAX_VALUE_CHARS];
+        char *end = format_influx_value(field_value, signal, value);
+        if (end) influx->append(buffer, line, index, field_value, static_cast<std::size_t>(end - field_value));
         return;
     }
 
-    union {
-        r16 data16;
-        r32 data32;
-        r64 data64;
-    } data {};
-
-    switch (data_type_registers(signal.data_type) * register_bytes(signal.register_type)) {
-        case 2: data.data16 = mem->at<uint16_t>(signal.base_index); break;
-        case 4: {
-            data.data32.u_data = *reinterpret_cast<uint32_t *>(mem->get_addr<uint16_t *>() + signal.base_index);
-            break;
+    char line_buffer[MAX_LINE_CHARS];
+    auto end = format_signal(line_buffer, signal, value);
+    buffer.append(line_buffer, end);
+}
+
+void MbOut::finish_output(std::string &buffer, InfluxFormat::line_t &line) const {
+    if (influx) influx->finish(buffer, line);
+}
+
+void MbOut::begin_output() {
+    if (!influx) return;
+
+    timespec ts {};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    influx->set_timestamp(ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+void MbOut::set_influx(const std::string &measurement, const std::string &tags) {
+    auto format = std::make_unique<InfluxFormat>(measurement, tags);
+
+    // field keys and series keys are rendered once
+    for (std::size_t i = 0; i < signals.size(); ++i) {
+        char       name[MAX_LINE_CHARS];
+        const auto name_end   = format_name(name, signals[i]);
+        const auto attributes = influx_attributes.find(i);
+        if (attributes == influx_attributes.end()) {
+            format->add_signal(std::string(name, name_end), std::string(), std::string());
+        } else {
+            const auto &attr = attributes->second;
+            format->add_signal(attr.field.empty() ? std::string(name, name_end) : attr.field,
+                               attr.measurement,
+                               attr.tags);
         }
-        case 8:
-            data.data64.u_data = *reinterpret_cast<uint64_t *>(mem->get_addr<uint16_t *>() + signal.base_index);
-            break;
-        default: throw std::logic_error("unexpected load size");
     }
 
-    switch (signal.data_type) {
-        case data_type_t::u8_lo: out << std::dec << "u8_lo:" << static_cast<unsigned>(data.data16.ub[0]); break;
-        case data_type_t::u8_hi: out << std::dec << "u8_hi:" << static_cast<unsigned>(data.data16.ub[1]); break;
-        case data_type_t::i8_lo: out << std::dec << "i8_lo:" << static_cast<int>(data.data16.ub[0]); break;
-        case data_type_t::i8_hi: out << std::dec << "i8_hi:" << static_cast<int>(data.data16.ub[1]); break;
-        case data_type_t::x8_lo: out << std::hex << "i8_lo:" << static_cast<unsigned>(data.data16.ub[0]); break;
-        case data_type_t::x8_hi: out << std::hex << "i8_hi:" << static_cast<unsigned>(data.data16.ub[1]); break;
-        case data_type_t::u16l: {
-            cxxendian::LE_Int<uint16_t> mem_e(data.data16.u_data);
-            out << std::dec << "u16l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::u16b: {
-            cxxendian::BE_Int<uint16_t> mem_e(data.data16.u_data);
-            out << std::dec << "u16b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::i16l: {
-            cxxendian::LE_Int<int16_t> mem_e(data.data16.i_data);
-            out << std::dec << "i16l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::i16b: {
-            cxxendian::BE_Int<int16_t> mem_e(data.data16.i_data);
-            out << std::dec << "i16b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::x16l: {
-            cxxendian::LE_Int<uint16_t> mem_e(data.data16.u_data);
-            out << std::hex << "x16l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::x16b: {
-            cxxendian::BE_Int<uint16_t> mem_e(data.data16.u_data);
-            out << std::hex << "x16b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::u32l: {
-            cxxendian::LE_Int<uint32_t> mem_e(data.data32.u_data);
-            out << std::dec << "u32l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::u32lr: {
-            std::swap(data.data32.reg[0], data.data32.reg[1]);
-            cxxendian::LE_Int<uint32_t> mem_e(data.data32.u_data);
-            out << std::dec << "u32lr:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::u32b: {
-            cxxendian::BE_Int<uint32_t> mem_e(data.data32.u_data);
-            out << std::dec << "u32b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::u32br: {
-            std::swap(data.data32.reg[0], data.data32.reg[1]);
-            cxxendian::BE_Int<uint32_t> mem_e(data.data32.u_data);
-            out << std::dec << "u32br:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::i32l: {
-            cxxendian::LE_Int<int32_t> mem_e(data.data32.i_data);
-            out << std::dec << "i32l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::i32lr: {
-            std::swap(data.data32.reg[0], data.data32.reg[1]);
-            cxxendian::LE_Int<int32_t> mem_e(data.data32.i_data);
-            out << std::dec << "i32lr:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::i32b: {
-            cxxendian::BE_Int<int32_t> mem_e(data.data32.i_data);
-            out << std::dec << "i32b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::i32br: {
-            std::swap(data.data32.reg[0], data.data32.reg[1]);
-            cxxendian::BE_Int<int32_t> mem_e(data.data32.i_data);
-            out << std::dec << "i32br:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::x32l: {
-            cxxendian::LE_Int<uint32_t> mem_e(data.data32.u_data);
-            out << std::hex << "x32l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::x32lr: {
-            std::swap(data.data32.reg[0], data.data32.reg[1]);
-            cxxendian::LE_Int<uint32_t> mem_e(data.data32.u_data);
-            out << std::hex << "x32lr:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::x32b: {
-            cxxendian::BE_Int<uint32_t> mem_e(data.data32.u_data);
-            out << std::hex << "x32b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::x32br: {
-            std::swap(data.data32.reg[0], data.data32.reg[1]);
-            cxxendian::BE_Int<uint32_t> mem_e(data.data32.u_data);
-            out << std::hex << "x32br:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::f32l: {
-            cxxendian::LE_Float<float> mem_e(data.data32.f_data);
-            out << std::scientific << std::setprecision(std::numeric_limits<float>::digits10)
-                << "f32l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::f32lr: {
-            std::swap(data.data32.reg[0], data.data32.reg[1]);
-            cxxendian::LE_Float<float> mem_e(data.data32.f_data);
-            out << std::scientific << std::setprecision(std::numeric_limits<float>::digits10)
-                << "f32lr:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::f32b: {
-            cxxendian::BE_Float<float> mem_e(data.data32.f_data);
-            out << std::scientific << std::setprecision(std::numeric_limits<float>::digits10)
-                << "f32b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::f32br: {
-            std::swap(data.data32.reg[0], data.data32.reg[1]);
-            cxxendian::BE_Float<float> mem_e(data.data32.f_data);
-            out << std::scientific << std::setprecision(std::numeric_limits<float>::digits10)
-                << "f32br:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::u64l: {
-            cxxendian::LE_Int<uint64_t> mem_e(data.data64.u_data);
-            out << std::dec << "u64l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::u64lr: {
-            std::swap(data.data64.reg[0], data.data64.reg[3]);
-            std::swap(data.data64.reg[1], data.data64.reg[2]);
-            cxxendian::LE_Int<uint64_t> mem_e(data.data64.u_data);
-            out << std::dec << "u64lr:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::u64b: {
-            cxxendian::BE_Int<uint64_t> mem_e(data.data64.u_data);
-            out << std::dec << "u64b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::u64br: {
-            std::swap(data.data64.reg[0], data.data64.reg[3]);
-            std::swap(data.data64.reg[1], data.data64.reg[2]);
-            cxxendian::BE_Int<uint64_t> mem_e(data.data64.u_data);
-            out << std::dec << "u64br:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::i64l: {
-            cxxendian::LE_Int<int64_t> mem_e(data.data64.i_data);
-            out << std::dec << "i64l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::i64lr: {
-            std::swap(data.data64.reg[0], data.data64.reg[3]);
-            std::swap(data.data64.reg[1], data.data64.reg[2]);
-            cxxendian::LE_Int<int64_t> mem_e(data.data64.i_data);
-            out << std::dec << "i64lr:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::i64b: {
-            cxxendian::BE_Int<int64_t> mem_e(data.data64.i_data);
-            out << std::dec << "i64b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::i64br: {
-            std::swap(data.data64.reg[0], data.data64.reg[3]);
-            std::swap(data.data64.reg[1], data.data64.reg[2]);
-            cxxendian::BE_Int<int64_t> mem_e(data.data64.i_data);
-            out << std::dec << "i64br:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::x64l: {
-            cxxendian::LE_Int<uint64_t> mem_e(data.data64.u_data);
-            out << std::hex << "x64l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::x64lr: {
-            std::swap(data.data64.reg[0], data.data64.reg[3]);
-            std::swap(data.data64.reg[1], data.data64.reg[2]);
-            cxxendian::LE_Int<uint64_t> mem_e(data.data64.u_data);
-            out << std::hex << "x64lr:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::x64b: {
-            cxxendian::BE_Int<uint64_t> mem_e(data.data64.u_data);
-            out << std::hex << "x64b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::x64br: {
-            std::swap(data.data64.reg[0], data.data64.reg[3]);
-            std::swap(data.data64.reg[1], data.data64.reg[2]);
-            cxxendian::BE_Int<uint64_t> mem_e(data.data64.u_data);
-            out << std::hex << "x64br:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::f64l: {
-            cxxendian::LE_Float<double> mem_e(data.data64.f_data);
-            out << std::scientific << std::setprecision(std::numeric_limits<double>::digits10)
-                << "f64l:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::f64lr: {
-            std::swap(data.data64.reg[0], data.data64.reg[3]);
-            std::swap(data.data64.reg[1], data.data64.reg[2]);
-            cxxendian::LE_Float<double> mem_e(data.data64.f_data);
-            out << std::scientific << std::setprecision(std::numeric_limits<double>::digits10)
-                << "f64lr:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::f64b: {
-            cxxendian::BE_Float<double> mem_e(data.data64.f_data);
-            out << std::scientific << std::setprecision(std::numeric_limits<double>::digits10)
-                << "f64b:" << mem_e.get_raw();
-            break;
-        }
-        case data_type_t::f64br: {
-            std::swap(data.data64.reg[0], data.data64.reg[3]);
-            std::swap(data.data64.reg[1], data.data64.reg[2]);
-            cxxendian::BE_Float<double> mem_e(data.data64.f_data);
-            out << std::scientific << std::setprecision(std::numeric_limits<double>::digits10)
-                << "f64br:" << mem_e.get_raw();
-            break;
-        }
-        default: throw std::logic_error("unknown data type");
+    influx = std::move(format);
+}
+
+void MbOut::remove_signals(std::size_t first) {
+    if (first >= signals.size()) return;
+
+    std::size_t first_scaled = scaled_signals.size();
+    while (first_scaled > 0 && scaled_signals[first_scaled - 1] >= first)
+        --first_scaled;
+    scaled_signals.resize(first_scaled);
+    scaling.resize(first_scaled);
+
+    for (auto i = first; i < signals.size(); ++i)
+        influx_attributes.erase(i);
+
+    signals.resize(first);
+}
+
+void MbOut::prefault() {
+    // line protocol: a signal can be output twice per cycle (event mode: change and keyframe)
+    out_buffer.resize(influx ? 2 * influx->max_output() : max_cycle_output());
+    out_buffer.clear();
+
+    for (const auto *memory : {&modbus_do, &modbus_di, &modbus_ao, &modbus_ai})
+        prefault_memory(memory->get_addr<const void *>(), memory->get_size());
+}
+
+void MbOut::flush_output() {
+    finish_output(out_buffer, influx_line);
+
+    if (!out_buffer.empty()) {
+        out.write(out_buffer.data(), static_cast<std::streamsize>(out_buffer.size()));
+        out_buffer.clear();
     }
 
-    out << std::endl;
+    // also if there is no output: gives the output stream the chance to do its cyclic work
+    out.flush();
 }
@@ -5,24 +5,78 @@
 
 #pragma once
 
+#include "BatchDecoder.hpp"
+#include "InfluxFormat.hpp"
+#include "Scaling.hpp"
 #include "data_types.hpp"
+#include "decode.hpp"
+#include "format.hpp"
 
 #include "cxxshm.hpp"
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 class MbOut {
 protected:
+    /** scaling index of signals without scaling */
+    static constexpr std::size_t NO_SCALING = std::numeric_limits<std::size_t>::max();
+
     struct signal_t {
         data_type_t     data_type;
         register_type_t register_type;
         std::size_t     base_index;
-        signal_t() = default;
+        float_format_t  float_format = float_format_t::scientific;
+        std::size_t     scaling      = NO_SCALING;  // index in MbOut::scaling
+        signal_t()                   = default;
         signal_t(data_type_t data_type, register_type_t register_type, std::size_t base_index)
             : data_type(data_type), register_type(register_type), base_index(base_index) {}
+
+        /** scaled signals have float64 values */
+        [[nodiscard]] bool scaled() const noexcept { return scaling != NO_SCALING; }
     };
 
+    /** maximum length of one output line */
+    static constexpr std::size_t MAX_LINE_CHARS = 64 + MAX_VALUE_CHARS;
+
     std::vector<signal_t> signals;
 
+    /** consecutive signals with an individual cycle time (@cycle directive in the signal list) */
+    struct signal_group_t {
+        std::size_t cycle_ms;          // 0: default cycle time
+        std::size_t first;             // index of the first signal
+        std::size_t count;             // number of signals
+        std::size_t first_scaled = 0;  // index of the first scaling entry of the group
+        std::size_t scaled_count = 0;  // number of scaled signals
+    };
+
+    std::vector<signal_group_t> groups;
+
+    /** scaling of the signals with scale, offset, min or max attribute */
+    Scaling scaling;
+
+    /** signal index of each scaling entry */
+    std::vector<std::size_t> scaled_signals;
+
+    /** decoded (and scaled) values of the signals (same order as signals), see decode_signals() */
+    std::vector<value_t> values;
+
+    /** line protocol attributes of a signal (empty: default) */
+    struct influx_attributes_t {
+        std::string measurement;
+        std::string tags;
+        std::string field;
+    };
+
+    /** line protocol attributes of the signals that have any (key: signal index) */
+    std::unordered_map<std::size_t, influx_attributes_t> influx_attributes;
+
+    /** line protocol output (nullptr: text output) */
+    std::unique_ptr<InfluxFormat> influx;
+    InfluxFormat::line_t          influx_line;  // line state of out_buffer
+
     cxxshm::SharedMemory modbus_do;
     cxxshm::SharedMemory modbus_di;
     cxxshm::SharedMemory modbus_ao;
@@ -30,15 +84,169 @@ protected:
 
     std::ostream &out;
 
-    MbOut(const std::string &path, std::ostream &out, const std::string &name_prefix = "modbus_");
+    /** output of the current cycle (written to out by flush_output()) */
+    std::string out_buffer;
+
+    MbOut(const std::string &path,
+          std::ostream      &out,
+          const std::string &name_prefix  = "modbus_",
+          float_format_t     float_format = float_format_t::scientific);
+
+    cxxshm::SharedMemory &shm(register_type_t register_type);
+
+    /**
+     * \brief get the shared memory address of the first register (or coil) of a signal
+     */
+    const uint8_t *signal_addr(const signal_t &signal);
+
+    /**
+     * \brief format the output line of a signal
+     * @param dst output buffer (at least MAX_LINE_CHARS bytes)
+     * @param signal signal
+     * @param value decoded signal value
+     * @return pointer to the character after the line (including line break)
+     */
+    static char *format_signal(char *dst, const signal_t &signal, value_t value);
+
+    /**
+     * \brief format the name of a signal as in the output lines (e.g. "ao:2:f32l" or "do:3")
+     * @param dst output buffer (at least MAX_LINE_CHARS bytes)
+     * @param signal signal
+     * @return pointer to the character after the name
+     */
+    static char *format_name(char *dst, const signal_t &signal);
+
+    /**
+     * \brief format a signal value as line protocol field value
+     * @param dst output buffer (at least MAX_VALUE_CHARS bytes)
+     * @param signal signal
+     * @param value signal value
+     * @return pointer to the character after the value; nullptr if the value can not be represented (NaN, infinity)
+     */
+    static char *format_influx_value(char *dst, const signal_t &signal, value_t value);
+
+    /**
+     * \brief format a signal value (without signal prefix and line break)
+     * @param dst output buffer (at least MAX_VALUE_CHARS bytes)
+     * @param signal signal
+     * @param value signal value
+     * @return pointer to the character after the value
+     */
+    static char *format_value(char *dst, const signal_t &signal, value_t value);
 
-    virtual void output_signal(const signal_t &signal);
+    /** \brief value kind of a signal (float64 for scaled signals) */
+    static value_kind_t value_kind(const signal_t &signal);
+
+    /**
+     * \brief decode the value of a signal and apply its scaling
+     * @param signal signal
+     * @param addr address of the first register (or coil) of the signal (not necessarily in the shared memory)
+     */
+    [[nodiscard]] value_t decode_signal(const signal_t &signal, const void *addr) const;
+
+    /**
+     * \brief decode all signals from the shared memory to values
+     *
+     * The signals are decoded per data type (BatchDecoder), then the scaled signals of the group are scaled in one
+     * pass.
+     */
+    void decode_signals();
+
+    /**
+     * \brief decode the signals of one signal group from the shared memory to values
+     * @param group index of the signal group
+     */
+    void decode_signals(std::size_t group);
+
+    /**
+     * \brief scale the decoded values of consecutive scaling entries (in place in values)
+     *
+     * Calls for disjoint ranges of scaling entries may run concurrently.
+     *
+     * @param first index of the first scaling entry
+     * @param count number of scaling entries
+     */
+    void scale_signals(std::size_t first, std::size_t count);
+
+    /**
+     * \brief get the scaling entries of consecutive signals (the scaling entries are in signal list order)
+     * @param first index of the first signal
+     * @param count number of signals
+     * @param first_scaled index of the first scaling entry of the signals
+     * @param scaled_count number of scaled signals
+     */
+    void scaled_range(std::size_t first, std::size_t count, std::size_t &first_scaled, std::size_t &scaled_count) const;
+
+    /** \brief output a signal with its value from values */
+    virtual void output_signal(std::size_t index);
+
+    /**
+     * \brief append the output of a signal in the output format (text line or line protocol field)
+     * @param buffer output buffer
+     * @param line line protocol state of the buffer (terminated by finish_output())
+     * @param index signal index
+     * @param value signal value
+     */
+    void append_signal(std::string &buffer, InfluxFormat::line_t &line, std::size_t index, value_t value) const;
+
+    /** \brief terminate the output of a buffer (open line protocol line) */
+    void finish_output(std::string &buffer, InfluxFormat::line_t &line) const;
+
+    /** \brief start the output of a cycle (time stamp of the line protocol output) */
+    void begin_output();
+
+    void flush_output();
+
+    /**
+     * \brief maximum size of the output of one cycle
+     */
+    [[nodiscard]] virtual std::size_t max_cycle_output() const { return signals.size() * MAX_LINE_CHARS; }
+
+    /**
+     * \brief parse one line of a signal list (signal or directive) and append the signal to signals
+     */
+    virtual void parse_config(const std::string &line) final;
+
+    /**
+     * \brief remove the signals starting at index first (signals that were added after the construction)
+     *
+     * The signal count of the last group is not changed.
+     */
+    void remove_signals(std::size_t first);
 
 public:
     virtual ~MbOut() = default;
 
     virtual void cycle() = 0;
 
+    /**
+     * \brief allocate the output buffer for the largest possible output and prefault it and the shared memories
+     *
+     * Afterwards a cycle does not allocate memory or cause page faults in the output buffer or the shared memories.
+     */
+    void prefault();
+
+    /**
+     * \brief check if the signal list contains groups with individual cycle times
+     */
+    [[nodiscard]] bool has_signal_groups() const noexcept { return groups.size() > 1 || groups[0].cycle_ms != 0; }
+
+    /**
+     * \brief output in the InfluxDB line protocol instead of text lines
+     *
+     * The signal attributes measurement, tags and field override the defaults per signal. The default field key is
+     * the signal name of the text output (e.g. "ao:2:f32l").
+     *
+     * @param measurement default measurement
+     * @param tags default tags (comma separated key=value pairs)
+     */
+    void set_influx(const std::string &measurement, const std::string &tags);
+
 private:
-    virtual void parse_config(const std::string &line) final;
+    float_format_t default_float_format;
+
+    /** one batch decoder per signal group */
+    std::vector<BatchDecoder> decoders;
+
+    void parse_directive(const std::string &directive);
 };
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "QueryServer.hpp"
+
+#include "would_block.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+
+/** maximum length of a request line */
+static constexpr std::size_t MAX_REQUEST = 64 * 1024;
+
+/** maximum size of the replies that are not yet sent to a client */
+static constexpr std::size_t MAX_PENDING_REPLY = 16 * 1024 * 1024;
+
+QueryServer::QueryServer(const std::string                                      &path,
+                         std::ostream                                           &out,
+                         std::string                                             socket_path,
+                         const std::vector<std::pair<std::string, std::string>> &signal_sets,
+                         const std::string                                      &name_prefix,
+                         float_format_t                                          float_format)
+    : MbOut(path, out, name_prefix, float_format), socket_path(std::move(socket_path)) {
+    sets[""] = {0, signals.size()};
+
+    for (const auto &[name, file] : signal_sets) {
+        if (name.empty() || name.find_first_of(" \t") != std::string::npos)
+            throw std::invalid_argument("invalid signal set name '" + name + '\'');
+        if (sets.count(name)) throw std::invalid_argument("duplicate signal set '" + name + '\'');
+
+        std::ifstream infile(file);
+        if (!infile.is_open()) throw std::runtime_error("failed to open signal set '" + file + '\'');
+
+        const auto  first = signals.size();
+        std::string line;
+        for (std::size_t line_number = 1; std::getline(infile, line); ++line_number) {
+            try {
+                parse_config(line);
+            } catch (const std::exception &e) {
+                std::ostringstream sstr;
+                sstr << "signal set '" << name << "': failed to parse line " << line_number << " (" << line
+                     << "): " << e.what();
+                throw std::runtime_error(sstr.str());
+            }
+        }
+        if (infile.bad()) throw std::runtime_error("failed to read signal set '" + file + '\'');
+
+        sets[name] = {first, signals.size() - first};
+    }
+
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (this->socket_path.size() >= sizeof(addr.sun_path)) throw std::invalid_argument("socket path too long");
+    strncpy(addr.sun_path, this->socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) throw std::system_error(errno, std::generic_category(), "failed to create socket");
+
+    // remove stale socket (but do not steal the socket of a running instance)
+    const int probe_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe_fd >= 0) {
+        const bool in_use = connect(probe_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+        close(probe_fd);
+        if (in_use) {
+            close(listen_fd);
+            throw std::runtime_error("socket '" + this->socket_path + "' is in use");
+        }
+    }
+    unlink(this->socket_path.c_str());
+
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) || listen(listen_fd, SOMAXCONN)) {
+        const int err = errno;
+        close(listen_fd);
+        throw std::system_error(err, std::generic_category(), "failed to bind socket '" + this->socket_path + '\'');
+    }
+}
+
+QueryServer::~QueryServer() {
+    for (auto &client : clients)
+        close(client.fd);
+    close(listen_fd);
+    unlink(socket_path.c_str());
+}
+
+void QueryServer::wait(int timeout_ms) {
+    std::vector<pollfd> fds;
+    fds.reserve(clients.size() + 1);
+    fds.push_back({listen_fd, POLLIN, 0});
+    for (const auto &client : clients)
+        fds.push_back({client.fd, static_cast<short>(client.out.empty() ? POLLIN : POLLIN | POLLOUT), 0});
+
+    if (::poll(fds.data(), fds.size(), timeout_ms) < 0 && errno != EINTR)
+        throw std::system_error(errno, std::generic_category(), "poll");
+}
+
+void QueryServer::cycle() {
+    accept_clients();
+
+    for (std::size_t i = 0; i < clients.size();) {
+        auto &client = clients[i];
+        if (receive(client) && send_pending(client)) {
+            ++i;
+            continue;
+        }
+
+        close(client.fd);
+        clients[i] = std::move(clients.back());
+        clients.pop_back();
+    }
+}
+
+void QueryServer::accept_clients() {
+    for (;;) {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (!would_block(errno) && errno != EINTR)
+                std::cerr << "WARNING: query server: accept failed: " << strerror(errno) << std::endl;
+            return;
+        }
+        clients.push_back({fd, std::string(), std::string()});
+    }
+}
+
+bool QueryServer::receive(client_t &client) {
+    char buffer[4096];
+    for (;;) {
+        const auto ret = recv(client.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (ret == 0) return false;
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            if (would_block(errno)) break;
+            return false;
+        }
+        client.in.append(buffer, static_cast<std::size_t>(ret));
+        if (static_cast<std::size_t>(ret) < sizeof(buffer)) break;
+    }
+
+    std::size_t begin = 0;
+    for (auto end = client.in.find('\n'); end != std::string::npos; end = client.in.find('\n', begin)) {
+        auto request = client.in.substr(begin, end - begin);
+        if (!request.empty() && request.back() == '\r') request.pop_back();
+        handle_request(request, client.out);
+        begin = end + 1;
+    }
+    client.in.erase(0, begin);
+
+    // a client that does not send line breaks or does not read its replies
+    return client.in.size() <= MAX_REQUEST && client.out.size() - client.out_offset <= MAX_PENDING_REPLY;
+}
+
+bool QueryServer::send_pending(client_t &client) {
+    while (client.out_offset < client.out.size()) {
+        const auto ret = send(client.fd,
+                              client.out.data() + client.out_offset,
+                              client.out.size() - client.out_offset,
+                              MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return would_block(errno);
+        }
+        client.out_offset += static_cast<std::size_t>(ret);
+    }
+
+    client.out.clear();
+    client.out_offset = 0;
+    return true;
+}
+
+void QueryServer::append_signals(std::size_t first, std::size_t count, std::string &reply) {
+    char line[MAX_LINE_CHARS];
+    for (std::size_t i = first; i < first + count; ++i) {
+        const auto &signal = signals[i];
+        reply.append(line, format_signal(line, signal, decode_signal(signal, signal_addr(signal))));
+    }
+}
+
+void QueryServer::handle_request(const std::string &request, std::string &reply) {
+    if (!request.empty() && request[0] == '@') {
+        const auto set = sets.find(request.substr(1));
+        if (set == sets.end()) reply += "error:unknown signal set '" + request.substr(1) + "'\n";
+        else
+            append_signals(set->second.first, set->second.count, reply);
+        reply += '\n';
+        return;
+    }
+
+    // the signals of the request are parsed into the signal table and removed afterwards
+    const auto first       = signals.size();
+    const auto group_count = groups.back().count;
+    try {
+        std::istringstream stream(request);
+        std::string        spec;
+        while (stream >> spec) {
+            if (spec[0] == '@' || spec[0] == '#') throw std::runtime_error("invalid signal '" + spec + '\'');
+            try {
+                parse_config(spec);
+            } catch (const std::exception &e) {
+                throw std::runtime_error(spec + ": " + e.what());
+            }
+        }
+        append_signals(first, signals.size() - first, reply);
+    } catch (const std::exception &e) {
+        reply += "error:";
+        reply += e.what();
+        reply += '\n';
+    }
+    remove_signals(first);
+    groups.back().count = group_count;
+    reply += '\n';
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "MbOut.hpp"
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief answer read requests via a unix domain socket
+ *
+ * Protocol (one request per line, each reply is terminated by an empty line):
+ *  - "@"                         read the signals of the signal list
+ *  - "@NAME"                     read the signals of the signal set NAME
+ *  - "<signal> [<signal> ...]"   read the specified signals (signal list syntax, separated by white space)
+ * The reply contains one line per signal (same format as the cyclic output) or the line "error:<message>".
+ * Clients that send a request line longer than 64 KiB or do not read more than 16 MiB of replies are disconnected.
+ */
+class QueryServer : public MbOut {
+private:
+    struct range_t {
+        std::size_t first;
+        std::size_t count;
+    };
+
+    struct client_t {
+        int         fd;
+        std::string in;
+        std::string out;
+        std::size_t out_offset = 0;
+    };
+
+    std::string                              socket_path;
+    int                                      listen_fd = -1;
+    std::unordered_map<std::string, range_t> sets;
+    std::vector<client_t>                    clients;
+
+    void accept_clients();
+
+    /** \brief read and handle requests; returns false if the client is disconnected */
+    bool receive(client_t &client);
+
+    /** \brief send the pending replies; returns false if the client is disconnected */
+    static bool send_pending(client_t &client);
+
+    void handle_request(const std::string &request, std::string &reply);
+    void append_signals(std::size_t first, std::size_t count, std::string &reply);
+
+public:
+    /**
+     * \brief create query server
+     * @param path signal list (answered for the request "@")
+     * @param out output stream (not used)
+     * @param socket_path path of the unix domain socket
+     * @param signal_sets named signal sets: name and signal list
+     * @param name_prefix shared memory name prefix
+     * @param float_format default float format
+     */
+    QueryServer(const std::string                                      &path,
+                std::ostream                                           &out,
+                std::string                                             socket_path,
+                const std::vector<std::pair<std::string, std::string>> &signal_sets,
+                const std::string                                      &name_prefix  = "modbus_",
+                float_format_t                                          float_format = float_format_t::scientific);
+
+    ~QueryServer() override;
+
+    QueryServer(const QueryServer &)            = delete;
+    QueryServer &operator=(const QueryServer &) = delete;
+
+    /** \brief handle all pending connections and requests (does not block) */
+    void cycle() override;
+
+    /**
+     * \brief wait for connections or requests
+     * @param timeout_ms maximum wait time (-1: no limit); signals interrupt the wait
+     */
+    void wait(int timeout_ms);
+};
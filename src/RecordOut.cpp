@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "RecordOut.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <system_error>
+#include <unistd.h>
+
+/** approximate size of one chunk of the recording file */
+static constexpr std::size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+static std::size_t round_up(std::size_t value, std::size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+RecordOut::RecordOut(const std::string &path,
+                     std::ostream      &out,
+                     const std::string &file,
+                     const std::string &name_prefix)
+    : MbOut(path, out, name_prefix) {
+    // covered byte ranges per register type (merged)
+    struct interval_t {
+        std::size_t register_type;
+        std::size_t begin;
+        std::size_t end;
+        bool        operator<(const interval_t &other) const {
+            return register_type < other.register_type ||
+                   (register_type == other.register_type && begin < other.begin);
+        }
+    };
+
+    std::vector<interval_t> intervals;
+    intervals.reserve(signals.size());
+    for (const auto &signal : signals) {
+        const auto bytes = register_bytes(signal.register_type);
+        const auto begin = signal.base_index * bytes;
+        intervals.push_back({static_cast<std::size_t>(signal.register_type),
+                             begin,
+                             begin + data_type_registers(signal.data_type) * bytes});
+    }
+    std::sort(intervals.begin(), intervals.end());
+
+    std::vector<interval_t> merged;
+    for (const auto &interval : intervals) {
+        if (!merged.empty() && merged.back().register_type == interval.register_type &&
+            interval.begin <= merged.back().end)
+            merged.back().end = std::max(merged.back().end, interval.end);
+        else
+            merged.push_back(interval);
+    }
+
+    static constexpr register_type_t REGISTER_TYPES[] = {
+            register_type_t::DO, register_type_t::DI, register_type_t::AO, register_type_t::AI};
+
+    std::size_t size = sizeof(int64_t);
+    for (const auto &interval : merged) {
+        const auto &memory = shm(REGISTER_TYPES[interval.register_type]);
+        ranges.push_back({memory.get_addr<const uint8_t *>() + interval.begin, interval.end - interval.begin, size});
+        size += interval.end - interval.begin;
+    }
+
+    const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    record_size          = round_up(size, sizeof(int64_t));
+    chunk_records        = std::max<std::size_t>(CHUNK_SIZE / record_size, 1);
+    chunk_size           = round_up(chunk_records * record_size, page_size);
+    header_map_size = round_up(sizeof(recording_header_t) + merged.size() * sizeof(recording_range_t), page_size);
+    data_offset     = header_map_size;
+
+    if (record_size > std::numeric_limits<uint32_t>::max() || merged.size() > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("recorded ranges too large");
+
+    fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "failed to open '" + file + '\'');
+
+    if (ftruncate(fd, static_cast<off_t>(header_map_size))) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "failed to resize '" + file + '\'');
+    }
+
+    auto *map = mmap(nullptr, header_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "failed to map '" + file + '\'');
+    }
+
+    header = new (map) recording_header_t();
+    memcpy(header->magic, RECORDING_MAGIC, sizeof(header->magic));
+    header->version       = RECORDING_VERSION;
+    header->range_count   = static_cast<uint32_t>(merged.size());
+    header->record_size   = static_cast<uint32_t>(record_size);
+    header->chunk_records = static_cast<uint32_t>(chunk_records);
+    header->chunk_size    = chunk_size;
+    header->data_offset   = data_offset;
+    for (std::size_t i = 0; i < 4; ++i)
+        header->shm_size[i] = shm(REGISTER_TYPES[i]).get_size();
+    header->record_count.store(0, std::memory_order_relaxed);
+
+    auto *range_table = reinterpret_cast<recording_range_t *>(header + 1);
+    for (std::size_t i = 0; i < merged.size(); ++i) {
+        range_table[i].register_type = static_cast<uint32_t>(merged[i].register_type);
+        range_table[i].offset        = static_cast<uint32_t>(merged[i].begin);
+        range_table[i].size          = static_cast<uint32_t>(merged[i].end - merged[i].begin);
+        range_table[i].record_offset = static_cast<uint32_t>(ranges[i].record_offset);
+    }
+
+    try {
+        map_chunk(0);
+    } catch (...) {
+        munmap(header, header_map_size);
+        close(fd);
+        throw;
+    }
+}
+
+RecordOut::~RecordOut() {
+    if (chunk) munmap(chunk, chunk_size);
+
+    // remove the unused part of the last chunk
+    const auto end = data_offset + chunk_index * chunk_size + chunk_record * record_size;
+    if (ftruncate(fd, static_cast<off_t>(end))) { /* the file is valid anyway (record count) */
+    }
+
+    munmap(header, header_map_size);
+    close(fd);
+}
+
+void RecordOut::map_chunk(uint64_t index) {
+    if (chunk) {
+        munmap(chunk, chunk_size);
+        chunk = nullptr;
+    }
+
+    const auto offset = data_offset + index * chunk_size;
+    if (ftruncate(fd, static_cast<off_t>(offset + chunk_size)))
+        throw std::system_error(errno, std::generic_category(), "failed to extend recording");
+
+    auto *map = mmap(nullptr, chunk_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(offset));
+    if (map == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "failed to map recording");
+
+    chunk        = static_cast<uint8_t *>(map);
+    chunk_index  = index;
+    chunk_record = 0;
+}
+
+void RecordOut::cycle() {
+    if (chunk_record == chunk_records) map_chunk(chunk_index + 1);
+
+    auto    *record = chunk + chunk_record * record_size;
+    timespec ts {};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    const int64_t time_ns = ts.tv_sec * 1000000000 + ts.tv_nsec;
+    memcpy(record, &time_ns, sizeof(time_ns));
+
+    for (const auto &range : ranges)
+        memcpy(record + range.record_offset, range.shm, range.size);
+
+    ++chunk_record;
+    header->record_count.store(++record_count, std::memory_order_release);
+
+    // gives the output stream the chance to do its cyclic work
+    flush_output();
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "MbOut.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Recording file layout (native byte order):
+ *
+ * offset                          | content
+ * --------------------------------+------------------------------------------------------------
+ * 0                               | recording_header_t
+ * sizeof(recording_header_t)      | recording_range_t[range_count]
+ * data_offset + k * chunk_size    | chunk k: chunk_records records of record_size bytes
+ *
+ * Record i is located at data_offset + (i / chunk_records) * chunk_size + (i % chunk_records) * record_size.
+ * Each record starts with the time stamp (int64_t, unix time in ns), followed by the bytes of all ranges.
+ * Records have a fixed size, so the time stamps can be searched with a binary search.
+ */
+
+static constexpr char     RECORDING_MAGIC[8] = {'M', 'B', 'S', 'H', 'M', 'R', 'E', 'C'};
+static constexpr uint32_t RECORDING_VERSION  = 1;
+
+struct recording_header_t {
+    char                  magic[8];       /**< RECORDING_MAGIC */
+    uint32_t              version;        /**< RECORDING_VERSION */
+    uint32_t              range_count;    /**< number of recorded ranges */
+    uint32_t              record_size;    /**< bytes per record */
+    uint32_t              chunk_records;  /**< records per chunk */
+    uint64_t              chunk_size;     /**< bytes per chunk (multiple of the page size) */
+    uint64_t              data_offset;    /**< offset of the first chunk (multiple of the page size) */
+    uint64_t              shm_size[4];    /**< size of the shared memories (do, di, ao, ai) */
+    std::atomic<uint64_t> record_count;   /**< number of complete records */
+    uint8_t               reserved[48];   /**< 0 */
+};
+
+struct recording_range_t {
+    uint32_t register_type;  /**< 0: do, 1: di, 2: ao, 3: ai */
+    uint32_t offset;         /**< offset in the shared memory (bytes) */
+    uint32_t size;           /**< size (bytes) */
+    uint32_t record_offset;  /**< offset in the record (bytes) */
+};
+
+static_assert(sizeof(recording_header_t) == 128);
+static_assert(sizeof(recording_range_t) == 16);
+
+/**
+ * \brief record the raw register values of each cycle to an append only file
+ *
+ * Only the register ranges that are covered by the signals are recorded. The file is written via a memory mapping
+ * that is extended chunk by chunk.
+ */
+class RecordOut : public MbOut {
+private:
+    struct range_t {
+        const uint8_t *shm;
+        std::size_t    size;
+        std::size_t    record_offset;
+    };
+
+    int                  fd = -1;
+    recording_header_t  *header;
+    std::vector<range_t> ranges;
+    std::size_t          record_size;
+    std::size_t          chunk_records;
+    std::size_t          chunk_size;
+    std::size_t          data_offset;
+    std::size_t          header_map_size;
+    uint8_t             *chunk        = nullptr;  // mapping of the current chunk
+    uint64_t             chunk_index  = 0;        // index of the current chunk
+    std::size_t          chunk_record = 0;        // next record in the current chunk
+    uint64_t             record_count = 0;
+
+    void map_chunk(uint64_t index);
+
+public:
+    /**
+     * \brief create recording
+     * @param path signal list
+     * @param out output stream (not used for the recording)
+     * @param file recording file (truncated if it exists)
+     * @param name_prefix shared memory name prefix
+     */
+    RecordOut(const std::string &path,
+              std::ostream      &out,
+              const std::string &file,
+              const std::string &name_prefix = "modbus_");
+
+    ~RecordOut() override;
+
+    RecordOut(const RecordOut &)            = delete;
+    RecordOut &operator=(const RecordOut &) = delete;
+
+    void cycle() override;
+};
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Replay.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+Replay::Replay(const std::string &file) {
+    fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "failed to open '" + file + '\'');
+
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat)) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "failed to stat '" + file + '\'');
+    }
+    map_size = static_cast<std::size_t>(file_stat.st_size);
+
+    if (map_size < sizeof(recording_header_t)) {
+        close(fd);
+        throw std::runtime_error("'" + file + "' is not a recording");
+    }
+
+    auto *addr = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "failed to map '" + file + '\'');
+    }
+    map    = static_cast<const uint8_t *>(addr);
+    header = reinterpret_cast<const recording_header_t *>(map);
+
+    try {
+        if (memcmp(header->magic, RECORDING_MAGIC, sizeof(header->magic)) != 0)
+            throw std::runtime_error("'" + file + "' is not a recording");
+        if (header->version != RECORDING_VERSION)
+            throw std::runtime_error("unsupported recording version " + std::to_string(header->version));
+        if (header->record_size < sizeof(int64_t) || header->chunk_records == 0 ||
+            header->chunk_size < std::size_t {header->chunk_records} * header->record_size ||
+            header->data_offset < sizeof(recording_header_t) + header->range_count * sizeof(recording_range_t))
+            throw std::runtime_error("'" + file + "' is corrupted");
+
+        // the record count of an interrupted recording may exceed the data in the file
+        const auto records_in_file = [this]() -> uint64_t {
+            if (map_size <= header->data_offset) return 0;
+            const auto data   = map_size - header->data_offset;
+            const auto chunks = data / header->chunk_size;
+            const auto rest   = std::min<uint64_t>((data % header->chunk_size) / header->record_size,
+                                                 header->chunk_records);
+            return chunks * header->chunk_records + rest;
+        }();
+        record_count = std::min(header->record_count.load(std::memory_order_acquire), records_in_file);
+
+        prefix = "modbus_replay_" + std::to_string(getpid()) + '_';
+        static constexpr const char *NAMES[] = {"DO", "DI", "AO", "AI"};
+        for (std::size_t i = 0; i < 4; ++i) {
+            const auto size = std::max<std::size_t>(header->shm_size[i], 1);
+            shms.emplace_back(std::make_unique<cxxshm::SharedMemory>(prefix + NAMES[i], size, false, true));
+            memset(shms.back()->get_addr(), 0, size);
+        }
+
+        const auto *range_table = reinterpret_cast<const recording_range_t *>(header + 1);
+        for (std::size_t i = 0; i < header->range_count; ++i) {
+            const auto &range = range_table[i];
+            if (range.register_type >= 4 ||
+                std::size_t {range.offset} + range.size > header->shm_size[range.register_type] ||
+                std::size_t {range.record_offset} + range.size > header->record_size)
+                throw std::runtime_error("'" + file + "' is corrupted");
+            ranges.push_back(
+                    {shms[range.register_type]->get_addr<uint8_t *>() + range.offset, range.size, range.record_offset});
+        }
+    } catch (...) {
+        munmap(const_cast<uint8_t *>(map), map_size);
+        close(fd);
+        throw;
+    }
+}
+
+Replay::~Replay() {
+    munmap(const_cast<uint8_t *>(map), map_size);
+    close(fd);
+}
+
+bool Replay::next(int64_t &timestamp_ns) {
+    if (next_record == record_count) return false;
+
+    const auto *record = map + header->data_offset + (next_record / header->chunk_records) * header->chunk_size +
+                         (next_record % header->chunk_records) * header->record_size;
+    ++next_record;
+
+    memcpy(&timestamp_ns, record, sizeof(timestamp_ns));
+    for (const auto &range : ranges)
+        memcpy(range.shm, record + range.record_offset, range.size);
+
+    return true;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "RecordOut.hpp"
+#include "cxxshm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * \brief replay a recording (see RecordOut) via private shared memories
+ *
+ * The shared memories are created with a process specific name prefix (see name_prefix()). The outputs are created
+ * with this prefix and decode the replayed values like live register values.
+ * Registers that are not part of the recording read as 0.
+ */
+class Replay {
+private:
+    struct range_t {
+        uint8_t    *shm;
+        std::size_t size;
+        std::size_t record_offset;
+    };
+
+    int                                                fd  = -1;
+    const uint8_t                                     *map = nullptr;
+    std::size_t                                        map_size;
+    const recording_header_t                          *header;
+    std::string                                        prefix;
+    std::vector<std::unique_ptr<cxxshm::SharedMemory>> shms;
+    std::vector<range_t>                               ranges;
+    uint64_t                                           record_count;
+    uint64_t                                           next_record = 0;
+
+public:
+    /**
+     * \brief open recording and create the shared memories
+     * @param file recording file
+     */
+    explicit Replay(const std::string &file);
+
+    ~Replay();
+
+    Replay(const Replay &)            = delete;
+    Replay &operator=(const Replay &) = delete;
+
+    /** \brief shared memory name prefix of the replayed registers */
+    [[nodiscard]] const std::string &name_prefix() const { return prefix; }
+
+    /** \brief number of records in the recording */
+    [[nodiscard]] uint64_t records() const { return record_count; }
+
+    /**
+     * \brief copy the next record to the shared memories
+     * @param timestamp_ns time stamp of the record (unix time in ns)
+     * @return false if there are no more records
+     */
+    bool next(int64_t &timestamp_ns);
+};
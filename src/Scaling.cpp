@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Scaling.hpp"
+
+std::size_t Scaling::add(const parameters_t &parameters) {
+    scale.push_back(parameters.scale);
+    offset.push_back(parameters.offset);
+    min.push_back(parameters.min);
+    max.push_back(parameters.max);
+    raw_values.push_back(0.0);
+    values.push_back(0.0);
+    return scale.size() - 1;
+}
+
+void Scaling::resize(std::size_t count) {
+    if (count >= size()) return;
+    for (auto *column : {&scale, &offset, &min, &max, &raw_values, &values})
+        column->resize(count);
+}
+
+/**
+ * \brief scale n values (the arrays must not overlap: allows the compiler to vectorize the loop without runtime checks)
+ */
+static void scale_values(std::size_t              n,
+                         const double *__restrict scale,
+                         const double *__restrict offset,
+                         const double *__restrict min,
+                         const double *__restrict max,
+                         const double *__restrict raw,
+                         double *__restrict       values) {
+    for (std::size_t i = 0; i < n; ++i)
+        values[i] = Scaling::scale_value(raw[i], scale[i], offset[i], min[i], max[i]);
+}
+
+void Scaling::evaluate(std::size_t first, std::size_t count) {
+    scale_values(count,
+                 scale.data() + first,
+                 offset.data() + first,
+                 min.data() + first,
+                 max.data() + first,
+                 raw_values.data() + first,
+                 values.data() + first);
+}
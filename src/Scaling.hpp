@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+/**
+ * \brief linear scaling of raw values to engineering units: value = clamp(raw * scale + offset, min, max)
+ *
+ * Parameters, raw values and results are stored as structure of arrays: evaluate() scales all values in one loop
+ * without branches that the compiler vectorizes.
+ */
+class Scaling {
+public:
+    struct parameters_t {
+        double scale  = 1.0;
+        double offset = 0.0;
+        double min    = -std::numeric_limits<double>::infinity();
+        double max    = std::numeric_limits<double>::infinity();
+    };
+
+    /**
+     * \brief add an entry
+     * @param parameters scaling parameters
+     * @return index of the entry
+     */
+    std::size_t add(const parameters_t &parameters);
+
+    /** \brief remove the entries starting at index count */
+    void resize(std::size_t count);
+
+    [[nodiscard]] std::size_t size() const noexcept { return scale.size(); }
+
+    /** \brief input of evaluate(): one raw value per entry */
+    [[nodiscard]] double *raw() noexcept { return raw_values.data(); }
+
+    /**
+     * \brief scale raw values
+     * @param first index of the first entry
+     * @param count number of entries
+     */
+    void evaluate(std::size_t first, std::size_t count);
+
+    /** \brief result of the last evaluate() */
+    [[nodiscard]] double value(std::size_t index) const { return values[index]; }
+
+    /** \brief scale a single value (same result as evaluate()) */
+    [[nodiscard]] double apply(std::size_t index, double raw) const {
+        return scale_value(raw, scale[index], offset[index], min[index], max[index]);
+    }
+
+    /** \brief scale a value (NaN is passed through) */
+    static inline double scale_value(double raw, double scale, double offset, double min, double max) {
+        const double value   = raw * scale + offset;
+        const double clamped = min > value ? min : value;
+        return max < clamped ? max : clamped;
+    }
+
+private:
+    std::vector<double> scale;
+    std::vector<double> offset;
+    std::vector<double> min;
+    std::vector<double> max;
+    std::vector<double> raw_values;
+    std::vector<double> values;
+};
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "ShmTableOut.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <new>
+#include <stdexcept>
+
+ShmTableOut::ShmTableOut(const std::string &path,
+                         std::ostream      &out,
+                         const std::string &table_name,
+                         const std::string &name_prefix)
+    : MbOut(path, out, name_prefix) {
+    static_assert(sizeof(value_t) == 8);
+
+    const auto n = signals.size();
+    if (n > std::numeric_limits<uint32_t>::max()) throw std::runtime_error("too many signals for shared memory table");
+
+    const std::size_t descriptor_offset = sizeof(shm_table_header_t);
+    const std::size_t value_offset      = (descriptor_offset + n * sizeof(shm_table_descriptor_t) + 63) / 64 * 64;
+    const std::size_t size              = value_offset + std::max<std::size_t>(n, 1) * sizeof(value_t);
+    if (value_offset > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("too many signals for shared memory table");
+
+    table = std::make_unique<cxxshm::SharedMemory>(table_name, size, false, true);
+    auto *base = table->get_addr<uint8_t *>();
+    memset(base, 0, size);
+
+    auto *descriptors = reinterpret_cast<shm_table_descriptor_t *>(base + descriptor_offset);
+    for (std::size_t i = 0; i < n; ++i)
+        descriptors[i] = describe_signal(signals[i]);
+
+    slots = reinterpret_cast<value_t *>(base + value_offset);
+
+    header                    = new (base) shm_table_header_t();
+    header->version           = SHM_TABLE_VERSION;
+    header->header_size       = sizeof(shm_table_header_t);
+    header->signal_count      = static_cast<uint32_t>(n);
+    header->slot_size         = sizeof(value_t);
+    header->descriptor_offset = static_cast<uint32_t>(descriptor_offset);
+    header->descriptor_size   = sizeof(shm_table_descriptor_t);
+    header->value_offset      = static_cast<uint32_t>(value_offset);
+    header->sequence.store(0, std::memory_order_relaxed);
+
+    // written last: readers can check the magic to see if the table is initialized
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_TABLE_MAGIC;
+}
+
+shm_table_descriptor_t ShmTableOut::describe_signal(const signal_t &signal) {
+    shm_table_descriptor_t descriptor {};
+    descriptor.register_type = static_cast<uint8_t>(signal.register_type);
+    descriptor.value_kind    = static_cast<uint8_t>(value_kind(signal));
+    descriptor.registers     = static_cast<uint8_t>(data_type_registers(signal.data_type));
+    descriptor.index         = signal.base_index;
+    strncpy(descriptor.label, data_type_label(signal.data_type), sizeof(descriptor.label) - 1);
+    return descriptor;
+}
+
+void ShmTableOut::cycle() {
+    timespec ts {};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    decode_signals();
+
+    const auto seq = header->sequence.load(std::memory_order_relaxed);
+    header->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::copy(values.begin(), values.end(), slots);
+    header->cycle += 1;
+    header->timestamp_ns = ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+    header->sequence.store(seq + 2, std::memory_order_release);
+
+    // gives the output stream the chance to do its cyclic work
+    flush_output();
+}
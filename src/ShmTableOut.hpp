@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "MbOut.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+ * Layout of the shared memory table (native byte order, all offsets relative to the start of the segment):
+ *
+ * offset              | content
+ * --------------------+------------------------------------------------------
+ * 0                   | shm_table_header_t
+ * descriptor_offset   | shm_table_descriptor_t[signal_count] (constant)
+ * value_offset        | value slots: 8 bytes per signal, in signal list order
+ *
+ * Value slots contain the decoded value (byte order and register order already applied):
+ *  - value_kind 0 (unsigned) and 2 (hex): uint64_t
+ *  - value_kind 1 (signed): int64_t
+ *  - value_kind 3 (float32): float in the first 4 bytes of the slot
+ *  - value_kind 4 (float64): double
+ * Coils are unsigned values (0 or 1).
+ *
+ * Readers must use the sequence counter (seqlock) to get a consistent cycle:
+ *  1. s1 = sequence (acquire); retry if s1 is odd
+ *  2. copy the required value slots
+ *  3. acquire fence; s2 = sequence; retry if s1 != s2
+ */
+
+static constexpr uint32_t SHM_TABLE_MAGIC   = 0x5453424D;  // "MBST"
+static constexpr uint16_t SHM_TABLE_VERSION = 1;
+
+struct alignas(64) shm_table_header_t {
+    uint32_t              magic;              /**< SHM_TABLE_MAGIC */
+    uint16_t              version;            /**< SHM_TABLE_VERSION */
+    uint16_t              header_size;        /**< sizeof(shm_table_header_t) */
+    uint32_t              signal_count;       /**< number of signals */
+    uint32_t              slot_size;          /**< size of one value slot (8) */
+    uint32_t              descriptor_offset;  /**< offset of the descriptor table */
+    uint32_t              descriptor_size;    /**< size of one descriptor */
+    uint32_t              value_offset;       /**< offset of the first value slot (64 byte aligned) */
+    uint32_t              reserved;           /**< 0 */
+    std::atomic<uint64_t> sequence;           /**< seqlock counter: odd while the values are written */
+    uint64_t              cycle;              /**< number of completed cycles */
+    int64_t               timestamp_ns;       /**< time of the last cycle (unix time in ns) */
+};
+
+struct shm_table_descriptor_t {
+    uint8_t  register_type;  /**< 0: do, 1: di, 2: ao, 3: ai */
+    uint8_t  value_kind;     /**< see layout description */
+    uint8_t  registers;      /**< number of registers (coils) of the signal */
+    uint8_t  reserved[5];    /**< 0 */
+    uint64_t index;          /**< index of the first register (coil) */
+    char     label[16];      /**< data type label (as in the text output, empty for coils, zero terminated) */
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "lock free 64 bit atomics required");
+static_assert(sizeof(shm_table_header_t) == 64);
+static_assert(sizeof(shm_table_descriptor_t) == 32);
+
+/**
+ * \brief write the decoded values of each cycle to a shared memory table
+ */
+class ShmTableOut : public MbOut {
+private:
+    std::unique_ptr<cxxshm::SharedMemory> table;
+    shm_table_header_t                   *header = nullptr;
+    value_t                              *slots  = nullptr;
+
+public:
+    /**
+     * \brief create shared memory table output
+     * @param path signal list
+     * @param out output stream (not used for values)
+     * @param table_name name of the shared memory table (must not exist)
+     * @param name_prefix shared memory name prefix of the modbus registers
+     */
+    ShmTableOut(const std::string &path,
+                std::ostream      &out,
+                const std::string &table_name,
+                const std::string &name_prefix = "modbus_");
+
+    void cycle() override;
+
+    /** \brief descriptor of a signal (also used by the event ring) */
+    static shm_table_descriptor_t describe_signal(const signal_t &signal);
+};
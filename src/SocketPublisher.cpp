@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "SocketPublisher.hpp"
+
+#include "would_block.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+
+/** maximum number of chunks that are sent with one system call */
+static constexpr std::size_t MAX_IOV = 64;
+
+SocketPublisher::SocketPublisher(std::string path, std::size_t queue_length, slow_consumer_policy_t policy)
+    : path(std::move(path)), policy(policy), chunks(queue_length + 1) {
+    if (queue_length == 0) throw std::invalid_argument("queue length must not be 0");
+
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (this->path.size() >= sizeof(addr.sun_path)) throw std::invalid_argument("socket path too long");
+    strncpy(addr.sun_path, this->path.c_str(), sizeof(addr.sun_path) - 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) throw std::system_error(errno, std::generic_category(), "failed to create socket");
+
+    // remove stale socket (but do not steal the socket of a running instance)
+    const int probe_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe_fd >= 0) {
+        const bool in_use = connect(probe_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+        close(probe_fd);
+        if (in_use) {
+            close(listen_fd);
+            throw std::runtime_error("socket '" + this->path + "' is in use");
+        }
+    }
+    unlink(this->path.c_str());
+
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) || listen(listen_fd, SOMAXCONN)) {
+        const int err = errno;
+        close(listen_fd);
+        throw std::system_error(err, std::generic_category(), "failed to bind socket '" + this->path + '\'');
+    }
+
+    auto &c = chunk(head);
+    c.data.resize(4096);
+    setp(c.data.data(), c.data.data() + c.data.size());
+}
+
+SocketPublisher::~SocketPublisher() {
+    sync();
+    for (auto &subscriber : subscribers)
+        close(subscriber.fd);
+    close(listen_fd);
+    unlink(path.c_str());
+}
+
+SocketPublisher::int_type SocketPublisher::overflow(int_type ch) {
+    auto      &c    = chunk(head);
+    const auto used = static_cast<std::size_t>(pptr() - pbase());
+    c.data.resize(std::max<std::size_t>(c.data.size() * 2, 4096));
+    setp(c.data.data(), c.data.data() + c.data.size());
+    pbump(static_cast<int>(used));
+
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int SocketPublisher::sync() {
+    const auto size = static_cast<std::size_t>(pptr() - pbase());
+    if (size) {
+        chunk(head).size = size;
+        ++head;
+        handle_overrun();
+
+        auto &c = chunk(head);
+        if (c.data.empty()) c.data.resize(chunk(head - 1).data.size());
+        c.size = 0;
+        setp(c.data.data(), c.data.data() + c.data.size());
+    }
+
+    accept_subscribers();
+
+    for (std::size_t i = 0; i < subscribers.size();) {
+        if (send_pending(subscribers[i])) ++i;
+        else
+            disconnect(i);
+    }
+
+    return 0;
+}
+
+void SocketPublisher::accept_subscribers() {
+    for (;;) {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (!would_block(errno))
+                std::cerr << "WARNING: publisher: accept failed: " << strerror(errno) << std::endl;
+            return;
+        }
+
+        // subscribers never send data
+        shutdown(fd, SHUT_RD);
+        subscribers.emplace_back(fd, head);
+    }
+}
+
+void SocketPublisher::handle_overrun() {
+    // the chunk that is overwritten next
+    if (head < chunks.size()) return;
+    const auto oldest = head - chunks.size();
+
+    for (std::size_t i = 0; i < subscribers.size();) {
+        auto &subscriber = subscribers[i];
+        if (subscriber.seq > oldest) {
+            ++i;
+            continue;
+        }
+
+        if (policy == slow_consumer_policy_t::disconnect) {
+            std::cerr << "WARNING: publisher: disconnecting slow subscriber" << std::endl;
+            disconnect(i);
+            continue;
+        }
+
+        // keep the rest of a partially sent chunk to not break lines
+        if (subscriber.offset) {
+            const auto &c = chunk(oldest);
+            subscriber.partial.assign(c.data.data() + subscriber.offset, c.data.data() + c.size);
+            subscriber.partial_offset = 0;
+        }
+        subscriber.seq    = oldest + 1;
+        subscriber.offset = 0;
+        ++i;
+    }
+}
+
+bool SocketPublisher::send_pending(subscriber_t &subscriber) {
+    for (;;) {
+        iovec       iov[MAX_IOV];
+        std::size_t iov_count = 0;
+        std::size_t requested = 0;
+
+        const bool has_partial = subscriber.partial_offset < subscriber.partial.size();
+        if (has_partial) {
+            iov[iov_count].iov_base = subscriber.partial.data() + subscriber.partial_offset;
+            iov[iov_count].iov_len  = subscriber.partial.size() - subscriber.partial_offset;
+            requested += iov[iov_count].iov_len;
+            ++iov_count;
+        }
+
+        for (auto seq = subscriber.seq; seq < head && iov_count < MAX_IOV; ++seq) {
+            auto      &c      = chunk(seq);
+            const auto offset = seq == subscriber.seq ? subscriber.offset : 0;
+            iov[iov_count].iov_base = c.data.data() + offset;
+            iov[iov_count].iov_len  = c.size - offset;
+            requested += iov[iov_count].iov_len;
+            ++iov_count;
+        }
+
+        if (iov_count == 0) return true;
+
+        msghdr msg {};
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = iov_count;
+        const auto ret = sendmsg(subscriber.fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return would_block(errno);
+        }
+
+        // advance position
+        auto sent = static_cast<std::size_t>(ret);
+        if (has_partial) {
+            const auto n = std::min(sent, subscriber.partial.size() - subscriber.partial_offset);
+            subscriber.partial_offset += n;
+            sent -= n;
+            if (subscriber.partial_offset == subscriber.partial.size()) {
+                subscriber.partial.clear();
+                subscriber.partial_offset = 0;
+            }
+        }
+        while (sent) {
+            const auto remaining = chunk(subscriber.seq).size - subscriber.offset;
+            if (sent < remaining) {
+                subscriber.offset += sent;
+                sent = 0;
+            } else {
+                sent -= remaining;
+                ++subscriber.seq;
+                subscriber.offset = 0;
+            }
+        }
+
+        // socket buffer is full
+        if (static_cast<std::size_t>(ret) < requested) return true;
+    }
+}
+
+void SocketPublisher::disconnect(std::size_t index) {
+    close(subscribers[index].fd);
+    std::swap(subscribers[index], subscribers.back());
+    subscribers.pop_back();
+}
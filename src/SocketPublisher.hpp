@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/**
+ * \brief stream buffer that publishes the output to any number of subscribers via a unix domain socket
+ *
+ * Everything that is written between two calls of sync() (e.g. one cycle) forms a chunk. The last chunks are kept in
+ * a ring that is shared by all subscribers. Each subscriber has its own position in this ring. Data is sent
+ * non-blocking, so a slow subscriber never delays the caller or the other subscribers.
+ *
+ * If a subscriber falls behind by more than the length of the ring, the slow consumer policy is applied.
+ *
+ * New subscribers are accepted in sync() and receive all chunks that are completed after they connected.
+ */
+class SocketPublisher final : public std::streambuf {
+public:
+    enum class slow_consumer_policy_t {
+        disconnect, /**< disconnect the subscriber */
+        drop,       /**< drop the oldest chunks for this subscriber */
+    };
+
+    /**
+     * \brief create socket publisher
+     * @param path path of the unix domain socket
+     * @param queue_length number of chunks that are kept for slow subscribers
+     * @param policy what to do with subscribers that fall behind more than queue_length chunks
+     */
+    SocketPublisher(std::string path, std::size_t queue_length, slow_consumer_policy_t policy);
+
+    ~SocketPublisher() override;
+
+    SocketPublisher(const SocketPublisher &)            = delete;
+    SocketPublisher &operator=(const SocketPublisher &) = delete;
+
+protected:
+    int_type overflow(int_type ch) override;
+    int      sync() override;
+
+private:
+    struct chunk_t {
+        std::vector<char> data;
+        std::size_t       size = 0;
+    };
+
+    struct subscriber_t {
+        int               fd;
+        uint64_t          seq;         // next chunk to send
+        std::size_t       offset = 0;  // bytes of chunk seq that are already sent
+        std::vector<char> partial;     // unsent rest of a dropped chunk
+        std::size_t       partial_offset = 0;
+
+        subscriber_t(int fd, uint64_t seq) : fd(fd), seq(seq) {}
+    };
+
+    std::string               path;
+    int                       listen_fd = -1;
+    slow_consumer_policy_t    policy;
+    std::vector<chunk_t>      chunks;
+    uint64_t                  head = 0;  // sequence number of the chunk that is currently written
+    std::vector<subscriber_t> subscribers;
+
+    chunk_t &chunk(uint64_t seq) { return chunks[seq % chunks.size()]; }
+
+    void accept_subscribers();
+
+    /** apply the slow consumer policy to subscribers that still need the chunk that will be overwritten next */
+    void handle_overrun();
+
+    /**
+     * \brief send as much pending data as possible to a subscriber
+     * @return false if the subscriber disconnected
+     */
+    bool send_pending(subscriber_t &subscriber);
+
+    void disconnect(std::size_t index);
+};
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "StateFile.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+StateFile::StateFile(const std::string &path, uint64_t layout_hash, std::size_t state_size)
+    : map_size(sizeof(state_file_header_t) + state_size) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "failed to open '" + path + '\'');
+
+    // two processes that use the same state file would overwrite each others state
+    if (flock(fd, LOCK_EX | LOCK_NB)) {
+        const int err = errno;
+        close(fd);
+        if (err == EWOULDBLOCK) throw std::runtime_error("state file '" + path + "' is used by another process");
+        throw std::system_error(err, std::generic_category(), "failed to lock '" + path + '\'');
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st)) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "failed to stat '" + path + '\'');
+    }
+    const auto file_size = static_cast<std::size_t>(st.st_size);
+
+    // a file of a different size can not contain a valid state: start with an empty file
+    if (file_size != map_size) {
+        if (ftruncate(fd, 0) || ftruncate(fd, static_cast<off_t>(map_size))) {
+            const int err = errno;
+            close(fd);
+            throw std::system_error(err, std::generic_category(), "failed to resize '" + path + '\'');
+        }
+    }
+
+    auto *map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        const int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "failed to map '" + path + '\'');
+    }
+
+    header = static_cast<state_file_header_t *>(map);
+    state  = static_cast<uint8_t *>(map) + sizeof(state_file_header_t);
+
+    if (file_size == map_size && memcmp(header->magic, STATE_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version == STATE_FILE_VERSION && header->valid == 1 && header->layout_hash == layout_hash &&
+        header->state_size == state_size) {
+        file_status = status_t::loaded;
+        return;
+    }
+    if (file_size != 0) {
+        const bool same_layout = memcmp(header->magic, STATE_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+                                 header->version == STATE_FILE_VERSION && header->layout_hash == layout_hash &&
+                                 header->state_size == state_size;
+        file_status = same_layout ? status_t::interrupted : status_t::mismatch;
+    }
+
+    // invalid until the new state is committed
+    header = new (map) state_file_header_t();
+    memcpy(header->magic, STATE_FILE_MAGIC, sizeof(header->magic));
+    header->version     = STATE_FILE_VERSION;
+    header->valid       = 0;
+    header->layout_hash = layout_hash;
+    header->state_size  = state_size;
+}
+
+StateFile::~StateFile() {
+    // the mapping is written back by the kernel anyway; synchronous write back on a regular shutdown
+    msync(header, map_size, MS_SYNC);
+    munmap(header, map_size);
+    close(fd);
+}
+
+void StateFile::commit() {
+    if (msync(header, map_size, MS_SYNC))
+        throw std::system_error(errno, std::generic_category(), "failed to write state file");
+    header->valid = 1;
+}
+
+void StateFile::begin_update() noexcept {
+    // a crash is the only reader: the stores must only not be reordered by the compiler
+    header->valid = 0;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+void StateFile::end_update() noexcept {
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    header->valid = 1;
+}
+
+uint64_t StateFile::hash(uint64_t hash, const void *data, std::size_t size) noexcept {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3;
+    }
+    return hash;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * State file layout (native byte order):
+ *
+ * offset                      | content
+ * ----------------------------+------------------------------------------------------------
+ * 0                           | state_file_header_t
+ * sizeof(state_file_header_t) | state (state_size bytes, 64 byte aligned)
+ *
+ * The state is only valid if the layout hash matches the current signal list and valid is 1.
+ * valid is 0 while the state is modified (begin_update() .. end_update()).
+ */
+
+static constexpr char     STATE_FILE_MAGIC[8] = {'M', 'B', 'S', 'H', 'M', 'S', 'T', 'A'};
+static constexpr uint32_t STATE_FILE_VERSION  = 1;
+
+struct state_file_header_t {
+    char     magic[8];      /**< STATE_FILE_MAGIC */
+    uint32_t version;       /**< STATE_FILE_VERSION */
+    uint32_t valid;         /**< 1: the state was initialized completely and is not being modified */
+    uint64_t layout_hash;   /**< hash of the layout of the state (signal list) */
+    uint64_t state_size;    /**< size of the state (bytes) */
+    uint8_t  reserved[32];  /**< 0 */
+};
+
+static_assert(sizeof(state_file_header_t) == 64);
+
+/**
+ * \brief state that is kept in a memory mapped file
+ *
+ * The state is modified directly in the mapping, so it is written to the file by the kernel without additional
+ * copies or system calls. It survives a restart or crash of the process, but not necessarily a power loss.
+ * The file is locked (flock) while it is used.
+ */
+class StateFile {
+public:
+    enum class status_t {
+        created,      /**< new state (file did not exist or was empty) */
+        loaded,       /**< valid state loaded from the file */
+        mismatch,     /**< the file contained a state of a different layout (discarded) */
+        interrupted,  /**< the file contained a state that was being modified (discarded) */
+    };
+
+    /**
+     * \brief open or create a state file
+     * @param path file path
+     * @param layout_hash hash of the layout of the state
+     * @param state_size size of the state in bytes
+     */
+    StateFile(const std::string &path, uint64_t layout_hash, std::size_t state_size);
+
+    ~StateFile();
+
+    StateFile(const StateFile &)            = delete;
+    StateFile &operator=(const StateFile &) = delete;
+
+    [[nodiscard]] status_t status() const noexcept { return file_status; }
+
+    /** \brief state in the mapping (uninitialized if status() != loaded) */
+    [[nodiscard]] uint8_t *data() const noexcept { return state; }
+
+    /** \brief mark the state as initialized (call after a new state was written completely) */
+    void commit();
+
+    /**
+     * \brief mark the state as invalid before it is modified
+     *
+     * If the process stops before end_update(), the state is discarded by the next start (status interrupted).
+     */
+    void begin_update() noexcept;
+
+    /** \brief mark the state as valid again after begin_update() */
+    void end_update() noexcept;
+
+    /**
+     * \brief hash of arbitrary data (FNV-1a)
+     * @param hash previous hash (start with HASH_INIT)
+     * @param data data
+     * @param size size of the data
+     */
+    static uint64_t hash(uint64_t hash, const void *data, std::size_t size) noexcept;
+
+    static constexpr uint64_t HASH_INIT = 0xCBF29CE484222325;
+
+private:
+    int                  fd = -1;
+    std::size_t          map_size;
+    state_file_header_t *header;
+    uint8_t             *state;
+    status_t             file_status = status_t::created;
+};
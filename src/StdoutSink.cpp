@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "StdoutSink.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <system_error>
+#include <unistd.h>
+
+/** buffer size if vmsplice is not used */
+static constexpr std::size_t WRITE_BUFFER_SIZE = 64 * 1024;
+
+/** page aligned buffer (the pages stay valid while they are referenced by the pipe, also after munmap) */
+static char *allocate(std::size_t size) {
+    auto *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "failed to allocate output buffer");
+    return static_cast<char *>(addr);
+}
+
+bool StdoutSink::is_pipe(int fd) {
+    struct stat file_stat {};
+    return fstat(fd, &file_stat) == 0 && S_ISFIFO(file_stat.st_mode);
+}
+
+StdoutSink::StdoutSink(int fd, std::size_t pipe_size, bool zero_copy) : fd(fd) {
+    buffer_size = WRITE_BUFFER_SIZE;
+
+    if (zero_copy && is_pipe(fd)) {
+        // fails if the size exceeds /proc/sys/fs/pipe-max-size (unprivileged): the current size is kept
+        fcntl(fd, F_SETPIPE_SZ, static_cast<int>(pipe_size));
+
+        const int size = fcntl(fd, F_GETPIPE_SZ);
+        if (size > 0) {
+            buffer_size  = static_cast<std::size_t>(size);
+            use_vmsplice = true;
+        }
+    }
+
+    buffers[0] = allocate(buffer_size);
+    if (use_vmsplice) {
+        try {
+            buffers[1] = allocate(buffer_size);
+        } catch (...) {
+            munmap(buffers[0], buffer_size);
+            throw;
+        }
+    }
+
+    setp(buffers[0], buffers[0] + buffer_size);
+}
+
+StdoutSink::~StdoutSink() {
+    try {
+        flush_data();
+    } catch (const std::exception &) {
+        // nothing to do: the reader is gone
+    }
+
+    for (auto *buffer : buffers)
+        if (buffer) munmap(buffer, buffer_size);
+}
+
+void StdoutSink::write_data(const char *data, std::size_t size) {
+    while (size) {
+        const auto ret = ::write(fd, data, size);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "failed to write output");
+        }
+        data += ret;
+        size -= static_cast<std::size_t>(ret);
+    }
+}
+
+void StdoutSink::flush_data() {
+    auto *data = pbase();
+    auto  size = static_cast<std::size_t>(pptr() - pbase());
+
+    while (use_vmsplice && size) {
+        iovec      iov {data, size};
+        const auto ret = vmsplice(fd, &iov, 1, 0);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+
+            // e.g. not supported: the remaining data is written
+            write_data(data, size);
+            disable_vmsplice();
+            return;
+        }
+        data += ret;
+        size -= static_cast<std::size_t>(ret);
+    }
+
+    if (use_vmsplice) {
+        // continue after the output data (the pipe may still reference the data before)
+        setp(pptr(), epptr());
+    } else {
+        write_data(data, size);
+        setp(buffers[current], buffers[current] + buffer_size);
+    }
+}
+
+void StdoutSink::disable_vmsplice() {
+    // the pipe may still reference both buffers: they must not be written anymore
+    auto *buffer = allocate(WRITE_BUFFER_SIZE);
+    for (auto *&old : buffers) {
+        if (old) munmap(old, buffer_size);
+        old = nullptr;
+    }
+
+    use_vmsplice = false;
+    buffer_size  = WRITE_BUFFER_SIZE;
+    buffers[0]   = buffer;
+    current      = 0;
+    setp(buffers[0], buffers[0] + buffer_size);
+}
+
+void StdoutSink::switch_buffer() {
+    flush_data();
+    if (!use_vmsplice) return;
+
+    // the safety of the buffer reuse depends on the pipe size (the reader could have changed it)
+    const int size = fcntl(fd, F_GETPIPE_SZ);
+    if (size < 0 || static_cast<std::size_t>(size) > buffer_size) {
+        disable_vmsplice();
+        return;
+    }
+
+    current = 1 - current;
+    setp(buffers[current], buffers[current] + buffer_size);
+}
+
+StdoutSink::int_type StdoutSink::overflow(int_type ch) {
+    switch_buffer();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize StdoutSink::xsputn(const char *s, std::streamsize n) {
+    auto remaining = n;
+    while (remaining > 0) {
+        const auto space = epptr() - pptr();
+        if (space == 0) {
+            switch_buffer();
+            continue;
+        }
+
+        const auto chunk = std::min<std::streamsize>(space, remaining);
+        memcpy(pptr(), s, static_cast<std::size_t>(chunk));
+        pbump(static_cast<int>(chunk));
+        s += chunk;
+        remaining -= chunk;
+    }
+    return n;
+}
+
+int StdoutSink::sync() {
+    try {
+        flush_data();
+    } catch (const std::exception &) { return -1; }
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <streambuf>
+
+/**
+ * \brief output to a pipe via vmsplice (without copying the data to the kernel)
+ *
+ * The pipe is enlarged (F_SETPIPE_SZ) and two page aligned buffers of the pipe size are used alternately.
+ * A buffer is only reused after the complete other buffer was spliced into the pipe. At that time the pipe can not
+ * contain data of the reused buffer anymore, because it does not have the capacity for more than one buffer.
+ *
+ * If the file descriptor is not a pipe or vmsplice fails, write is used instead.
+ *
+ * Note: the pipe references the pages of the buffers until the data is read. Consumers that move the data out of the
+ * pipe with splice (instead of reading it) can see modified data.
+ */
+class StdoutSink final : public std::streambuf {
+public:
+    /**
+     * \brief create sink
+     * @param fd output file descriptor
+     * @param pipe_size requested pipe size (the actual size may be smaller if it exceeds the system limit)
+     * @param zero_copy use vmsplice if fd is a pipe
+     */
+    explicit StdoutSink(int fd, std::size_t pipe_size, bool zero_copy = true);
+
+    ~StdoutSink() override;
+
+    StdoutSink(const StdoutSink &)            = delete;
+    StdoutSink &operator=(const StdoutSink &) = delete;
+
+    /** \brief check if the file descriptor refers to a pipe */
+    static bool is_pipe(int fd);
+
+    /** \brief true if vmsplice is used */
+    [[nodiscard]] bool zero_copy() const noexcept { return use_vmsplice; }
+
+protected:
+    int_type        overflow(int_type ch) override;
+    std::streamsize xsputn(const char *s, std::streamsize n) override;
+    int             sync() override;
+
+private:
+    int         fd;
+    bool        use_vmsplice = false;
+    std::size_t buffer_size;
+    char       *buffers[2] = {nullptr, nullptr};
+    std::size_t current    = 0;
+
+    /** \brief output the data of the put area */
+    void flush_data();
+
+    /** \brief output the data and continue with the other buffer */
+    void switch_buffer();
+
+    void write_data(const char *data, std::size_t size);
+
+    /** \brief continue with write (and new buffers) */
+    void disable_vmsplice();
+};
@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * Column encodings of the archive (see ArchiveOut.hpp)
+ *
+ * All columns are bit streams (most significant bit first, last byte zero padded).
+ *
+ * time stamps (us):
+ *  - first sample: 64 bit
+ *  - second sample: delta as zig-zag varint
+ *  - other samples: zig-zag delta of delta (dod)
+ *      '0'                    dod == 0
+ *      '10'   + 7 bit         zig-zag(dod) < 2^7
+ *      '110'  + 9 bit         zig-zag(dod) < 2^9
+ *      '1110' + 12 bit        zig-zag(dod) < 2^12
+ *      '1111' + 64 bit        otherwise
+ *
+ * floating point values (Gorilla, width: 32 or 64 bit):
+ *  - first sample: raw bits
+ *  - other samples: x = bits XOR previous bits
+ *      '0'                                                          x == 0
+ *      '10' + meaningful bits                                       leading/trailing zeros within previous window
+ *      '11' + 5 bit leading zeros + 6 bit (length - 1) + meaningful bits
+ *
+ * integer values (including coils and hex values):
+ *  - first sample: zig-zag varint of the value
+ *  - other samples: '0' (unchanged) or '1' + zig-zag varint of the difference (modulo 2^64)
+ *
+ * varint: groups of 7 bit (least significant group first), 8th bit set if more groups follow.
+ */
+namespace archive {
+
+inline uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+class BitWriter {
+private:
+    std::vector<uint8_t> data;
+    uint64_t             acc  = 0;
+    unsigned             bits = 0;  // pending bits in acc (< 8 between calls)
+
+public:
+    /** \brief write the n least significant bits of value (n <= 64) */
+    void write(uint64_t value, unsigned n) {
+        if (n > 56) {
+            write(value >> 32, n - 32);
+            n = 32;
+        }
+        if (n < 64) value &= (uint64_t {1} << n) - 1;
+
+        acc = (acc << n) | value;
+        bits += n;
+        while (bits >= 8) {
+            bits -= 8;
+            data.push_back(static_cast<uint8_t>(acc >> bits));
+        }
+    }
+
+    void write_varint(uint64_t value) {
+        while (value >= 0x80) {
+            write((value & 0x7F) | 0x80, 8);
+            value >>= 7;
+        }
+        write(value, 8);
+    }
+
+    /** \brief number of bytes after finish() */
+    [[nodiscard]] std::size_t size() const { return data.size() + (bits ? 1 : 0); }
+
+    /** \brief write the pending bits (zero padded) */
+    void finish() {
+        if (bits) write(0, 8 - bits);
+    }
+
+    [[nodiscard]] const std::vector<uint8_t> &bytes() const { return data; }
+
+    void clear() {
+        data.clear();
+        acc  = 0;
+        bits = 0;
+    }
+};
+
+class BitReader {
+private:
+    const uint8_t *pos;
+    const uint8_t *end;
+    uint64_t       acc  = 0;
+    unsigned       bits = 0;
+
+public:
+    BitReader(const uint8_t *data, std::size_t size) : pos(data), end(data + size) {}
+
+    /** \brief read n bits (n <= 64) */
+    uint64_t read(unsigned n) {
+        if (n > 56) {
+            const auto high = read(n - 32);
+            return (high << 32) | read(32);
+        }
+
+        while (bits < n) {
+            if (pos == end) throw std::runtime_error("archive column truncated");
+            acc = (acc << 8) | *pos++;
+            bits += 8;
+        }
+        bits -= n;
+        return (acc >> bits) & ((uint64_t {1} << n) - 1);
+    }
+
+    uint64_t read_varint() {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            const auto byte = read(8);
+            value |= (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("invalid varint in archive column");
+    }
+};
+
+class TimestampEncoder {
+private:
+    BitWriter   writer;
+    int64_t     prev       = 0;
+    int64_t     prev_delta = 0;
+    std::size_t count      = 0;
+
+public:
+    void add(int64_t timestamp) {
+        if (count == 0) {
+            writer.write(static_cast<uint64_t>(timestamp), 64);
+        } else if (count == 1) {
+            prev_delta = timestamp - prev;
+            writer.write_varint(zigzag(prev_delta));
+        } else {
+            const auto delta = timestamp - prev;
+            const auto dod   = zigzag(delta - prev_delta);
+            prev_delta       = delta;
+            if (dod == 0) writer.write(0, 1);
+            else if (dod < (1 << 7))
+                writer.write((0b10u << 7) | dod, 2 + 7);
+            else if (dod < (1 << 9))
+                writer.write((0b110u << 9) | dod, 3 + 9);
+            else if (dod < (1 << 12))
+                writer.write((0b1110u << 12) | dod, 4 + 12);
+            else {
+                writer.write(0b1111, 4);
+                writer.write(dod, 64);
+            }
+        }
+        prev = timestamp;
+        ++count;
+    }
+
+    BitWriter &finish() {
+        writer.finish();
+        return writer;
+    }
+
+    void clear() {
+        writer.clear();
+        count = 0;
+    }
+};
+
+class TimestampDecoder {
+private:
+    BitReader   reader;
+    int64_t     prev       = 0;
+    int64_t     prev_delta = 0;
+    std::size_t count      = 0;
+
+public:
+    TimestampDecoder(const uint8_t *data, std::size_t size) : reader(data, size) {}
+
+    int64_t next() {
+        if (count == 0) {
+            prev = static_cast<int64_t>(reader.read(64));
+        } else if (count == 1) {
+            prev_delta = unzigzag(reader.read_varint());
+            prev += prev_delta;
+        } else {
+            uint64_t dod = 0;
+            if (reader.read(1)) {
+                if (!reader.read(1)) dod = reader.read(7);
+                else if (!reader.read(1))
+                    dod = reader.read(9);
+                else if (!reader.read(1))
+                    dod = reader.read(12);
+                else
+                    dod = reader.read(64);
+            }
+            prev_delta += unzigzag(dod);
+            prev += prev_delta;
+        }
+        ++count;
+        return prev;
+    }
+};
+
+/** XOR encoding of floating point values (bits: raw value, width: 32 or 64) */
+class FloatEncoder {
+private:
+    BitWriter   writer;
+    unsigned    width;
+    uint64_t    prev          = 0;
+    unsigned    prev_leading  = 0;
+    unsigned    prev_trailing = 0;
+    bool        window        = false;
+    std::size_t count         = 0;
+
+public:
+    explicit FloatEncoder(unsigned width) : width(width) {}
+
+    void add(uint64_t value) {
+        if (count++ == 0) {
+            writer.write(value, width);
+            prev = value;
+            return;
+        }
+
+        const auto x = value ^ prev;
+        prev         = value;
+        if (x == 0) {
+            writer.write(0, 1);
+            return;
+        }
+
+        const auto leading  = std::min<unsigned>(static_cast<unsigned>(__builtin_clzll(x)) - (64 - width), 31);
+        const auto trailing = static_cast<unsigned>(__builtin_ctzll(x));
+        if (window && leading >= prev_leading && trailing >= prev_trailing) {
+            writer.write(0b10, 2);
+            writer.write(x >> prev_trailing, width - prev_leading - prev_trailing);
+        } else {
+            const auto meaningful = width - leading - trailing;
+            writer.write(0b11, 2);
+            writer.write(leading, 5);
+            writer.write(meaningful - 1, 6);
+            writer.write(x >> trailing, meaningful);
+            prev_leading  = leading;
+            prev_trailing = trailing;
+            window        = true;
+        }
+    }
+
+    BitWriter &finish() {
+        writer.finish();
+        return writer;
+    }
+
+    void clear() {
+        writer.clear();
+        window = false;
+        count  = 0;
+    }
+};
+
+class FloatDecoder {
+private:
+    BitReader   reader;
+    unsigned    width;
+    uint64_t    prev          = 0;
+    unsigned    prev_leading  = 0;
+    unsigned    prev_trailing = 0;
+    std::size_t count         = 0;
+
+public:
+    FloatDecoder(const uint8_t *data, std::size_t size, unsigned width) : reader(data, size), width(width) {}
+
+    uint64_t next() {
+        if (count++ == 0) {
+            prev = reader.read(width);
+            return prev;
+        }
+
+        if (!reader.read(1)) return prev;
+
+        if (reader.read(1)) {
+            prev_leading          = static_cast<unsigned>(reader.read(5));
+            const auto meaningful = static_cast<unsigned>(reader.read(6)) + 1;
+            if (prev_leading + meaningful > width) throw std::runtime_error("invalid float in archive column");
+            prev_trailing = width - prev_leading - meaningful;
+        }
+        prev ^= reader.read(width - prev_leading - prev_trailing) << prev_trailing;
+        return prev;
+    }
+};
+
+class IntegerEncoder {
+private:
+    BitWriter   writer;
+    uint64_t    prev  = 0;
+    std::size_t count = 0;
+
+public:
+    void add(uint64_t value) {
+        if (count++ == 0) {
+            writer.write_varint(zigzag(static_cast<int64_t>(value)));
+        } else if (value == prev) {
+            writer.write(0, 1);
+        } else {
+            writer.write(1, 1);
+            writer.write_varint(zigzag(static_cast<int64_t>(value - prev)));
+        }
+        prev = value;
+    }
+
+    BitWriter &finish() {
+        writer.finish();
+        return writer;
+    }
+
+    void clear() {
+        writer.clear();
+        count = 0;
+    }
+};
+
+class IntegerDecoder {
+private:
+    BitReader   reader;
+    uint64_t    prev  = 0;
+    std::size_t count = 0;
+
+public:
+    IntegerDecoder(const uint8_t *data, std::size_t size) : reader(data, size) {}
+
+    uint64_t next() {
+        if (count++ == 0) prev = static_cast<uint64_t>(unzigzag(reader.read_varint()));
+        else if (reader.read(1))
+            prev += static_cast<uint64_t>(unzigzag(reader.read_varint()));
+        return prev;
+    }
+};
+
+}  // namespace archive
@@ -101,6 +101,108 @@ std::size_t data_type_registers(data_type_t data_type) {
     }
 }
 
+value_kind_t data_type_value_kind(data_type_t data_type) {
+    switch (data_type) {
+        case data_type_t::bit:
+        case data_type_t::u8_lo:
+        case data_type_t::u8_hi:
+        case data_type_t::i8_lo:
+        case data_type_t::i8_hi:
+        case data_type_t::u16l:
+        case data_type_t::u16b:
+        case data_type_t::u32l:
+        case data_type_t::u32lr:
+        case data_type_t::u32b:
+        case data_type_t::u32br:
+        case data_type_t::u64l:
+        case data_type_t::u64lr:
+        case data_type_t::u64b:
+        case data_type_t::u64br: return value_kind_t::unsigned_int;
+        case data_type_t::i16l:
+        case data_type_t::i16b:
+        case data_type_t::i32l:
+        case data_type_t::i32lr:
+        case data_type_t::i32b:
+        case data_type_t::i32br:
+        case data_type_t::i64l:
+        case data_type_t::i64lr:
+        case data_type_t::i64b:
+        case data_type_t::i64br: return value_kind_t::signed_int;
+        case data_type_t::x8_lo:
+        case data_type_t::x8_hi:
+        case data_type_t::x16l:
+        case data_type_t::x16b:
+        case data_type_t::x32l:
+        case data_type_t::x32lr:
+        case data_type_t::x32b:
+        case data_type_t::x32br:
+        case data_type_t::x64l:
+        case data_type_t::x64lr:
+        case data_type_t::x64b:
+        case data_type_t::x64br: return value_kind_t::hex;
+        case data_type_t::f32l:
+        case data_type_t::f32lr:
+        case data_type_t::f32b:
+        case data_type_t::f32br: return value_kind_t::float32;
+        case data_type_t::f64l:
+        case data_type_t::f64lr:
+        case data_type_t::f64b:
+        case data_type_t::f64br: return value_kind_t::float64;
+        default: throw std::logic_error("unknown data type");
+    }
+}
+
+const char *data_type_label(data_type_t data_type) {
+    switch (data_type) {
+        case data_type_t::bit: return "";
+        case data_type_t::u8_lo: return "u8_lo";
+        case data_type_t::u8_hi: return "u8_hi";
+        case data_type_t::i8_lo: return "i8_lo";
+        case data_type_t::i8_hi: return "i8_hi";
+        case data_type_t::x8_lo: return "i8_lo";
+        case data_type_t::x8_hi: return "i8_hi";
+        case data_type_t::u16l: return "u16l";
+        case data_type_t::u16b: return "u16b";
+        case data_type_t::i16l: return "i16l";
+        case data_type_t::i16b: return "i16b";
+        case data_type_t::x16l: return "x16l";
+        case data_type_t::x16b: return "x16b";
+        case data_type_t::u32l: return "u32l";
+        case data_type_t::u32lr: return "u32lr";
+        case data_type_t::u32b: return "u32b";
+        case data_type_t::u32br: return "u32br";
+        case data_type_t::i32l: return "i32l";
+        case data_type_t::i32lr: return "i32lr";
+        case data_type_t::i32b: return "i32b";
+        case data_type_t::i32br: return "i32br";
+        case data_type_t::x32l: return "x32l";
+        case data_type_t::x32lr: return "x32lr";
+        case data_type_t::x32b: return "x32b";
+        case data_type_t::x32br: return "x32br";
+        case data_type_t::u64l: return "u64l";
+        case data_type_t::u64lr: return "u64lr";
+        case data_type_t::u64b: return "u64b";
+        case data_type_t::u64br: return "u64br";
+        case data_type_t::i64l: return "i64l";
+        case data_type_t::i64lr: return "i64lr";
+        case data_type_t::i64b: return "i64b";
+        case data_type_t::i64br: return "i64br";
+        case data_type_t::x64l: return "x64l";
+        case data_type_t::x64lr: return "x64lr";
+        case data_type_t::x64b: return "x64b";
+        case data_type_t::x64br: return "x64br";
+        case data_type_t::f32l: return "f32l";
+        case data_type_t::f32lr: return "f32lr";
+        case data_type_t::f32b: return "f32b";
+        case data_type_t::f32br: return "f32br";
+        case data_type_t::f64l: return "f64l";
+        case data_type_t::f64lr: return "f64lr";
+        case data_type_t::f64b: return "f64b";
+        case data_type_t::f64br: return "f64br";
+        default: throw std::logic_error("unknown data type");
+    }
+}
+
 register_type_t str_to_register_type(const std::string &str) {
     try {
         return REGISTER_TYPE_MAP.at(str);
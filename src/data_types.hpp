@@ -61,6 +61,26 @@ data_type_t str_to_data_type(const std::string &str);
 
 std::size_t data_type_registers(data_type_t data_type);
 
+/**
+ * Representation of a decoded value
+ */
+enum class value_kind_t {
+    unsigned_int, /**< unsigned integer (output as decimal number) */
+    signed_int,   /**< signed integer (output as decimal number) */
+    hex,          /**< unsigned integer (output as hexadecimal number) */
+    float32,      /**< 32 bit floating point */
+    float64,      /**< 64 bit floating point */
+};
+
+value_kind_t data_type_value_kind(data_type_t data_type);
+
+/**
+ * \brief get the data type label that is used in the output
+ * @param data_type data type
+ * @return data type label (empty string for data_type_t::bit)
+ */
+const char *data_type_label(data_type_t data_type);
+
 enum class register_type_t {
     DO, /**< digital output register */
     DI, /**< digital input register */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "decode.hpp"
+
+#include <cstring>
+#include <cxxendian.hpp>
+#include <stdexcept>
+#include <utility>
+
+union r16 {
+    uint16_t reg;
+    uint16_t u_data;
+    int16_t  i_data;
+    uint8_t  ub[2];
+    int8_t   ib[2];
+    r16(uint16_t data) : u_data(data) {}  // NOLINT
+    r16() = default;
+};
+
+union r32 {
+    uint32_t u_data;
+    int32_t  i_data;
+    float    f_data;
+    uint16_t reg[2];
+    r32(uint32_t data) : u_data(data) {}  // NOLINT
+    r32() = default;
+};
+
+union r64 {
+    uint64_t u_data;
+    int64_t  i_data;
+    double   f_data;
+    uint16_t reg[4];
+    r64(uint64_t data) : u_data(data) {}  // NOLINT
+    r64() = default;
+};
+
+value_t decode_value(data_type_t data_type, const void *addr) {
+    value_t value {};
+
+    if (data_type == data_type_t::bit) {
+        value.u = *static_cast<const uint8_t *>(addr) ? 1 : 0;
+        return value;
+    }
+
+    union {
+        r16 data16;
+        r32 data32;
+        r64 data64;
+    } data {};
+
+    switch (data_type_registers(data_type)) {
+        case 1: memcpy(&data.data16.u_data, addr, sizeof(data.data16.u_data)); break;
+        case 2: memcpy(&data.data32.u_data, addr, sizeof(data.data32.u_data)); break;
+        case 4: memcpy(&data.data64.u_data, addr, sizeof(data.data64.u_data)); break;
+        default: throw std::logic_error("unexpected load size");
+    }
+
+    switch (data_type) {
+        case data_type_t::u8_lo:
+        case data_type_t::i8_lo:
+        case data_type_t::x8_lo: value.u = data.data16.ub[0]; break;
+        case data_type_t::u8_hi:
+        case data_type_t::i8_hi:
+        case data_type_t::x8_hi: value.u = data.data16.ub[1]; break;
+        case data_type_t::u16l:
+        case data_type_t::x16l: value.u = cxxendian::LE_Int<uint16_t>(data.data16.u_data).get_raw(); break;
+        case data_type_t::u16b:
+        case data_type_t::x16b: value.u = cxxendian::BE_Int<uint16_t>(data.data16.u_data).get_raw(); break;
+        case data_type_t::i16l: value.i = cxxendian::LE_Int<int16_t>(data.data16.i_data).get_raw(); break;
+        case data_type_t::i16b: value.i = cxxendian::BE_Int<int16_t>(data.data16.i_data).get_raw(); break;
+        case data_type_t::u32lr:
+        case data_type_t::x32lr: std::swap(data.data32.reg[0], data.data32.reg[1]); [[fallthrough]];
+        case data_type_t::u32l:
+        case data_type_t::x32l: value.u = cxxendian::LE_Int<uint32_t>(data.data32.u_data).get_raw(); break;
+        case data_type_t::u32br:
+        case data_type_t::x32br: std::swap(data.data32.reg[0], data.data32.reg[1]); [[fallthrough]];
+        case data_type_t::u32b:
+        case data_type_t::x32b: value.u = cxxendian::BE_Int<uint32_t>(data.data32.u_data).get_raw(); break;
+        case data_type_t::i32lr: std::swap(data.data32.reg[0], data.data32.reg[1]); [[fallthrough]];
+        case data_type_t::i32l: value.i = cxxendian::LE_Int<int32_t>(data.data32.i_data).get_raw(); break;
+        case data_type_t::i32br: std::swap(data.data32.reg[0], data.data32.reg[1]); [[fallthrough]];
+        case data_type_t::i32b: value.i = cxxendian::BE_Int<int32_t>(data.data32.i_data).get_raw(); break;
+        case data_type_t::f32lr: std::swap(data.data32.reg[0], data.data32.reg[1]); [[fallthrough]];
+        case data_type_t::f32l: value.f32 = cxxendian::LE_Float<float>(data.data32.f_data).get_raw(); break;
+        case data_type_t::f32br: std::swap(data.data32.reg[0], data.data32.reg[1]); [[fallthrough]];
+        case data_type_t::f32b: value.f32 = cxxendian::BE_Float<float>(data.data32.f_data).get_raw(); break;
+        case data_type_t::u64lr:
+        case data_type_t::x64lr:
+            std::swap(data.data64.reg[0], data.data64.reg[3]);
+            std::swap(data.data64.reg[1], data.data64.reg[2]);
+            [[fallthrough]];
+        case data_type_t::u64l:
+        case data_type_t::x64l: value.u = cxxendian::LE_Int<uint64_t>(data.data64.u_data).get_raw(); break;
+        case data_type_t::u64br:
+        case data_type_t::x64br:
+            std::swap(data.data64.reg[0], data.data64.reg[3]);
+            std::swap(data.data64.reg[1], data.data64.reg[2]);
+            [[fallthrough]];
+        case data_type_t::u64b:
+        case data_type_t::x64b: value.u = cxxendian::BE_Int<uint64_t>(data.data64.u_data).get_raw(); break;
+        case data_type_t::i64lr:
+            std::swap(data.data64.reg[0], data.data64.reg[3]);
+            std::swap(data.data64.reg[1], data.data64.reg[2]);
+            [[fallthrough]];
+        case data_type_t::i64l: value.i = cxxendian::LE_Int<int64_t>(data.data64.i_data).get_raw(); break;
+        case data_type_t::i64br:
+            std::swap(data.data64.reg[0], data.data64.reg[3]);
+            std::swap(data.data64.reg[1], data.data64.reg[2]);
+            [[fallthrough]];
+        case data_type_t::i64b: value.i = cxxendian::BE_Int<int64_t>(data.data64.i_data).get_raw(); break;
+        case data_type_t::f64lr:
+            std::swap(data.data64.reg[0], data.data64.reg[3]);
+            std::swap(data.data64.reg[1], data.data64.reg[2]);
+            [[fallthrough]];
+        case data_type_t::f64l: value.f64 = cxxendian::LE_Float<double>(data.data64.f_data).get_raw(); break;
+        case data_type_t::f64br:
+            std::swap(data.data64.reg[0], data.data64.reg[3]);
+            std::swap(data.data64.reg[1], data.data64.reg[2]);
+            [[fallthrough]];
+        case data_type_t::f64b: value.f64 = cxxendian::BE_Float<double>(data.data64.f_data).get_raw(); break;
+        default: throw std::logic_error("unknown data type");
+    }
+
+    return value;
+}
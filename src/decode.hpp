@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "data_types.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+
+/**
+ * Decoded signal value in native representation.
+ * The valid member is determined by data_type_value_kind().
+ */
+union value_t {
+    uint64_t u;   /**< value_kind_t::unsigned_int and value_kind_t::hex */
+    int64_t  i;   /**< value_kind_t::signed_int */
+    float    f32; /**< value_kind_t::float32 */
+    double   f64; /**< value_kind_t::float64 */
+};
+
+/**
+ * \brief decode a signal value
+ *
+ * Applies byte order and register order of the data type.
+ *
+ * @param data_type data type of the signal
+ * @param addr address of the first register (or coil) of the signal
+ * @return decoded value
+ */
+value_t decode_value(data_type_t data_type, const void *addr);
+
+/**
+ * \brief convert a decoded value to double
+ * @param kind value kind of the data type (data_type_value_kind())
+ * @param value decoded value
+ * @return value as double (integers with more than 53 significant bits are rounded)
+ */
+inline double value_to_double(value_kind_t kind, value_t value) {
+    switch (kind) {
+        case value_kind_t::unsigned_int:
+        case value_kind_t::hex: return static_cast<double>(value.u);
+        case value_kind_t::signed_int: return static_cast<double>(value.i);
+        case value_kind_t::float32: return static_cast<double>(value.f32);
+        case value_kind_t::float64: return value.f64;
+        default: throw std::logic_error("unknown value kind");
+    }
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "format.hpp"
+
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+const static std::unordered_map<std::string, float_format_t> FLOAT_FORMAT_MAP = {
+        {"scientific", float_format_t::scientific},
+        {"sci", float_format_t::scientific},
+        {"shortest", float_format_t::shortest},
+        {"short", float_format_t::shortest},
+};
+
+float_format_t str_to_float_format(const std::string &str) {
+    try {
+        return FLOAT_FORMAT_MAP.at(str);
+    } catch (const std::out_of_range &) { throw std::runtime_error("unknown float format string"); }
+}
+
+namespace format {
+
+/** "00" "01" ... "99" */
+static constexpr std::array<char, 200> DEC_PAIRS = []() {
+    std::array<char, 200> table {};
+    for (std::size_t i = 0; i < 100; ++i) {
+        table[2 * i]     = static_cast<char>('0' + i / 10);
+        table[2 * i + 1] = static_cast<char>('0' + i % 10);
+    }
+    return table;
+}();
+
+/** "00" "01" ... "ff" */
+static constexpr std::array<char, 512> HEX_PAIRS = []() {
+    constexpr char        DIGITS[] = "0123456789abcdef";
+    std::array<char, 512> table {};
+    for (std::size_t i = 0; i < 256; ++i) {
+        table[2 * i]     = DIGITS[i >> 4];
+        table[2 * i + 1] = DIGITS[i & 0xF];
+    }
+    return table;
+}();
+
+static constexpr std::array<uint64_t, 20> POW10 = []() {
+    std::array<uint64_t, 20> table {};
+    uint64_t                 p = 1;
+    for (auto &t : table) {
+        t = p;
+        p *= 10;
+    }
+    return table;
+}();
+
+/** number of decimal digits of value (1 for 0) without a loop: log10 estimated via bit width */
+static inline unsigned dec_digits(uint64_t value) {
+    value |= 1;
+    const auto t = static_cast<unsigned>(((64 - __builtin_clzll(value)) * 1233) >> 12);
+    return t + (value >= POW10[t] ? 1 : 0);
+}
+
+char *dec(char *dst, uint64_t value) {
+    char *const end = dst + dec_digits(value);
+    char       *p   = end;
+    while (value >= 100) {
+        p -= 2;
+        memcpy(p, &DEC_PAIRS[(value % 100) * 2], 2);
+        value /= 100;
+    }
+    if (value >= 10) {
+        p -= 2;
+        memcpy(p, &DEC_PAIRS[value * 2], 2);
+    } else {
+        *--p = static_cast<char>('0' + value);
+    }
+    return end;
+}
+
+char *dec(char *dst, int64_t value) {
+    auto abs = static_cast<uint64_t>(value);
+    if (value < 0) {
+        *dst++ = '-';
+        abs    = 0 - abs;
+    }
+    return dec(dst, abs);
+}
+
+char *hex(char *dst, uint64_t value) {
+    const auto  nibbles = static_cast<unsigned>((64 - __builtin_clzll(value | 1) + 3) / 4);
+    char *const end     = dst + nibbles;
+    char       *p       = end;
+    while (value >= 0x100) {
+        p -= 2;
+        memcpy(p, &HEX_PAIRS[(value & 0xFF) * 2], 2);
+        value >>= 8;
+    }
+    if (value >= 0x10) {
+        p -= 2;
+        memcpy(p, &HEX_PAIRS[value * 2], 2);
+    } else {
+        *--p = HEX_PAIRS[value * 2 + 1];
+    }
+    return end;
+}
+
+template <typename T>
+static inline char *flt_impl(char *dst, T value, float_format_t float_format) {
+    std::to_chars_result result {};
+    switch (float_format) {
+        case float_format_t::scientific:
+            result = std::to_chars(dst,
+                                   dst + MAX_VALUE_CHARS,
+                                   value,
+                                   std::chars_format::scientific,
+                                   std::numeric_limits<T>::digits10);
+            break;
+        case float_format_t::shortest: result = std::to_chars(dst, dst + MAX_VALUE_CHARS, value); break;
+        default: throw std::logic_error("unknown float format");
+    }
+    if (result.ec != std::errc()) throw std::logic_error("float format buffer too small");
+    return result.ptr;
+}
+
+char *flt(char *dst, float value, float_format_t float_format) {
+    return flt_impl(dst, value, float_format);
+}
+
+char *flt(char *dst, double value, float_format_t float_format) {
+    return flt_impl(dst, value, float_format);
+}
+
+char *value(char *dst, data_type_t data_type, value_t value, float_format_t float_format) {
+    switch (data_type_value_kind(data_type)) {
+        case value_kind_t::unsigned_int: return dec(dst, value.u);
+        case value_kind_t::signed_int: return dec(dst, value.i);
+        case value_kind_t::hex: return hex(dst, value.u);
+        case value_kind_t::float32: return flt(dst, value.f32, float_format);
+        case value_kind_t::float64: return flt(dst, value.f64, float_format);
+        default: throw std::logic_error("unknown value kind");
+    }
+}
+
+}  // namespace format
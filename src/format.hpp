@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "data_types.hpp"
+#include "decode.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Output format of floating point values
+ */
+enum class float_format_t {
+    scientific, /**< printf %e style with digits10 precision (compatible to previous versions) */
+    shortest,   /**< shortest representation that round trips to the same value */
+};
+
+float_format_t str_to_float_format(const std::string &str);
+
+/**
+ * Maximum number of characters written by any of the format functions
+ */
+constexpr std::size_t MAX_VALUE_CHARS = 32;
+
+/**
+ * The format functions write the string representation of a value to dst (no null termination).
+ * dst must provide at least MAX_VALUE_CHARS bytes.
+ * They return a pointer to the character after the last written one.
+ */
+namespace format {
+
+char *dec(char *dst, uint64_t value);
+char *dec(char *dst, int64_t value);
+char *hex(char *dst, uint64_t value);
+char *flt(char *dst, float value, float_format_t float_format);
+char *flt(char *dst, double value, float_format_t float_format);
+
+/**
+ * \brief format a decoded value according to its data type
+ */
+char *value(char *dst, data_type_t data_type, value_t value, float_format_t float_format);
+
+}  // namespace format
@@ -3,21 +3,47 @@
  * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
  */
 
+#include "AggregateOut.hpp"
+#include "ArchiveOut.hpp"
+#include "ArchiveReader.hpp"
+#include "CaptureOut.hpp"
+#include "ChangeNotifier.hpp"
 #include "CyclicOut.hpp"
 
 #include "EventOut.hpp"
+#include "Expression.hpp"
+#include "FileSink.hpp"
+#include "QueryServer.hpp"
+#include "RecordOut.hpp"
+#include "Replay.hpp"
+#include "ShmTableOut.hpp"
+#include "SocketPublisher.hpp"
+#include "StdoutSink.hpp"
 #include "cxxitimer.hpp"
 #include "cxxopts.hpp"
 #include "cxxsignal.hpp"
 #include "license.hpp"
+#include "realtime.hpp"
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <sysexits.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 constexpr std::size_t DEFAULT_CYCLE = 1000;  // 1s
 constexpr std::size_t DEFAULT_POLL  = 10;    // 10 ms
 
+constexpr std::size_t DEFAULT_PUBLISH_QUEUE = 256;   // cycles
+constexpr std::size_t DEFAULT_CHUNK_SIZE    = 4096;  // signals
+constexpr std::size_t DEFAULT_ARCHIVE_BLOCK = 1024;  // samples
+constexpr std::size_t DEFAULT_PIPE_SIZE     = 1024 * 1024;
+constexpr std::size_t DEFAULT_EVENT_RING    = 65536;  // records
+
 class TerminateHandler final : public cxxsignal::SignalHandler {
 private:
     static volatile bool _terminate;
@@ -30,21 +56,64 @@ public:
 
 volatile bool TerminateHandler::_terminate = false;
 
+class TriggerHandler final : public cxxsignal::SignalHandler {
+private:
+    static volatile bool _triggered;
+
+public:
+    explicit TriggerHandler(int signal_number) : cxxsignal::SignalHandler(signal_number) {}
+    void handler(int, siginfo_t *, ucontext_t *) override { _triggered = true; }
+
+    /** get and reset trigger state */
+    static inline bool triggered() {
+        const bool ret = _triggered;
+        _triggered     = false;
+        return ret;
+    }
+};
+
+volatile bool TriggerHandler::_triggered = false;
+
+class ReportHandler final : public cxxsignal::SignalHandler {
+private:
+    static volatile bool _requested;
+
+public:
+    explicit ReportHandler(int signal_number) : cxxsignal::SignalHandler(signal_number) {}
+    void handler(int, siginfo_t *, ucontext_t *) override { _requested = true; }
+
+    /** get and reset request state */
+    static inline bool requested() {
+        const bool ret = _requested;
+        _requested     = false;
+        return ret;
+    }
+};
+
+volatile bool ReportHandler::_requested = false;
+
 class CycleTimeWarning final : public cxxsignal::SignalHandler {
 private:
     volatile bool waiting = false;
+    volatile bool expired = false;
 
 public:
     explicit CycleTimeWarning(int signal_number) : cxxsignal::SignalHandler(signal_number), waiting(false) {}
 
     void handler(int signal_number, siginfo_t *, ucontext_t *context) override {
         if (!waiting) std::cerr << "WARNING: cycle time exceeded" << std::endl;
+        expired = true;
     }
 
     bool _wait() {
-        waiting  = true;
-        auto ret = wait();
-        waiting  = false;
+        waiting = true;
+        expired = false;
+        bool ret;
+        do {
+            // other signals (e.g. capture trigger) must not shorten the cycle
+            ret = wait();
+        } while (!expired && !TerminateHandler::terminate());
+        waiting = false;
         return ret;
     }
 };
@@ -55,6 +124,10 @@ int main(int argc, char **argv) {
     TerminateHandler quit_handler(SIGQUIT);
     CycleTimeWarning timer_handler(SIGALRM);
 
+    // SIGUSR2 and SIGUSR1 keep their default action unless capture mode or the change profile is active
+    std::unique_ptr<TriggerHandler> trigger_handler;
+    std::unique_ptr<ReportHandler>  report_handler;
+
     const std::string exe_name = std::filesystem::path(argv[0]).filename().string();
     cxxopts::Options  options(PROJECT_NAME, "Print Modbus shared memory data to stdout");
 
@@ -68,6 +141,151 @@ int main(int argc, char **argv) {
                           cxxopts::value<std::size_t>());
     options.add_options()("e,event", "enable event mode (output only changed signals)");
     options.add_options()("s,single", "enable single mode (output only once)");
+    options.add_options()("keyframe",
+                          "event mode: output the state of all signals every specified number of milliseconds. "
+                          "Keyframe lines are prefixed by 'kf:'.",
+                          cxxopts::value<std::size_t>());
+    options.add_options()("keyframe-spread",
+                          "event mode: distribute the output of a keyframe to the specified number of cycles. "
+                          "(default: 1)",
+                          cxxopts::value<std::size_t>());
+    options.add_options()("coil-groups",
+                          "event mode: output changed coils (do/di) in groups of up to 64 consecutive coils: "
+                          "<reg>:<first>..<last>:<hex mask>");
+    options.add_options()("profile-changes",
+                          "event mode: count the changes of each signal and write the change statistics (sorted by "
+                          "number of changes) to stderr on SIGUSR1 and at exit. See README.");
+    options.add_options()("state-file",
+                          "event mode: keep the last output state in the specified file (memory mapped). After a "
+                          "restart only the signals that differ from the stored state are written (no initial output "
+                          "of all signals).",
+                          cxxopts::value<std::string>());
+    options.add_options()("event-ring",
+                          "event mode: write the changes as records to a lock-free ring in a new shared memory with "
+                          "the specified name instead of writing text output. See README for the layout.",
+                          cxxopts::value<std::string>());
+    options.add_options()("event-ring-size",
+                          "event ring: number of records (rounded up to a power of 2). (default: " +
+                                  std::to_string(DEFAULT_EVENT_RING) + ')',
+                          cxxopts::value<std::size_t>());
+    options.add_options()("aggregate",
+                          "aggregation mode: sample the signals each cycle, but output only last, minimum, maximum, "
+                          "mean and number of samples of each signal every specified number of milliseconds.",
+                          cxxopts::value<std::size_t>());
+    options.add_options()("capture",
+                          "capture mode: keep the raw values of the specified number of milliseconds in memory. "
+                          "On a trigger (SIGUSR2 or --trigger) the values before and after the trigger are written.",
+                          cxxopts::value<std::size_t>());
+    options.add_options()("capture-post",
+                          "capture mode: number of milliseconds that are recorded after the trigger. (default: 0)",
+                          cxxopts::value<std::size_t>());
+    options.add_options()("trigger",
+                          "capture mode: trigger on an edge of a coil: <do|di>:<index>[:rising|falling|both] "
+                          "(default: rising). Can be specified multiple times.",
+                          cxxopts::value<std::vector<std::string>>());
+    options.add_options()("trigger-condition",
+                          "capture mode: trigger if the specified condition becomes true (see --condition). "
+                          "Can be specified multiple times.",
+                          cxxopts::value<std::vector<std::string>>());
+    options.add_options()("condition",
+                          "output a cycle only if the specified condition is true, e.g. "
+                          "'ai:10:f32b > 80.0 && di:3'. See README for the syntax.",
+                          cxxopts::value<std::string>());
+    options.add_options()("serve",
+                          "query daemon: answer read requests via the specified unix domain socket instead of cyclic "
+                          "output. See README for the protocol.",
+                          cxxopts::value<std::string>());
+    options.add_options()("signal-set",
+                          "query daemon: preload the named signal set NAME=SIGNAL_LIST. Can be specified multiple "
+                          "times.",
+                          cxxopts::value<std::vector<std::string>>());
+    options.add_options()("shm-table",
+                          "write the decoded values to a new shared memory with the specified name instead of "
+                          "writing text output. See README for the layout.",
+                          cxxopts::value<std::string>());
+    options.add_options()("record",
+                          "record the raw register values of each cycle to the specified file (instead of the output)",
+                          cxxopts::value<std::string>());
+    options.add_options()("archive",
+                          "write the values of each cycle to the specified compressed archive (instead of the output)",
+                          cxxopts::value<std::string>());
+    options.add_options()("archive-block",
+                          "archive: samples per block (default: " + std::to_string(DEFAULT_ARCHIVE_BLOCK) + ')',
+                          cxxopts::value<std::size_t>());
+    options.add_options()("read-archive",
+                          "decode the specified archive to the text format of the cyclic output and exit",
+                          cxxopts::value<std::string>());
+    options.add_options()("read-from",
+                          "read archive: skip samples before the specified time (unix time in seconds)",
+                          cxxopts::value<double>());
+    options.add_options()("replay",
+                          "replay the specified recording (instead of the modbus shared memory) and exit at its end",
+                          cxxopts::value<std::string>());
+    options.add_options()("replay-speed",
+                          "replay speed: recorded (time stamps of the recording) or fast (as fast as possible)",
+                          cxxopts::value<std::string>()->default_value("recorded"));
+    options.add_options()("notify",
+                          "event mode: wait for change notifications of the modbus client (shared memory "
+                          "'modbus_notify') instead of polling. --cycle is used as maximum wait time. Falls back to "
+                          "polling if the notification shared memory does not exist.");
+    options.add_options()("realtime",
+                          "real time profile: lock and prefault all memory, preallocate the output buffers, run the "
+                          "cycle with SCHED_FIFO (see --rt-priority) and optionally pinned to a cpu (see --rt-cpu).");
+    options.add_options()("rt-cpu", "real time profile: pin the cycle to the specified cpu", cxxopts::value<int>());
+    options.add_options()("rt-priority",
+                          "real time profile: SCHED_FIFO priority (default: " +
+                                  std::to_string(realtime_profile_t().priority) + ')',
+                          cxxopts::value<int>());
+    options.add_options()("threads",
+                          "cyclic mode: decode and format the signals with the specified number of threads. "
+                          "The output order is not affected. (default: 1)",
+                          cxxopts::value<std::size_t>());
+    options.add_options()("chunk-size",
+                          "cyclic mode: number of signals that are processed by a thread at once. (default: " +
+                                  std::to_string(DEFAULT_CHUNK_SIZE) + ')',
+                          cxxopts::value<std::size_t>());
+    options.add_options()("schedule",
+                          "cyclic mode: distribution of the chunks to the threads: static (default) or dynamic "
+                          "(work stealing)",
+                          cxxopts::value<std::string>());
+    options.add_options()("float-format",
+                          "default output format of floating point values: scientific (default) or shortest "
+                          "(shortest representation that round trips). Can be overridden per signal (fmt=...)",
+                          cxxopts::value<std::string>());
+    options.add_options()("influx",
+                          "output in the InfluxDB line protocol with the specified default measurement (cyclic, single "
+                          "and event mode). Can be overridden per signal (measurement=..., tags=..., field=...)",
+                          cxxopts::value<std::string>());
+    options.add_options()("influx-tags",
+                          "line protocol: default tags of all signals as comma separated key=value pairs "
+                          "(requires --influx)",
+                          cxxopts::value<std::string>());
+    options.add_options()("o,output",
+                          "write output to the specified file instead of stdout. The file is written asynchronously "
+                          "(io_uring if available), output is dropped if the storage can not keep up.",
+                          cxxopts::value<std::string>());
+    options.add_options()("rotate-size",
+                          "start a new output file after the specified number of bytes. The output files are named "
+                          "<OUTPUT>.<unix time in ms>. (requires --output)",
+                          cxxopts::value<std::size_t>());
+    options.add_options()("rotate-time",
+                          "start a new output file after the specified number of seconds. (requires --output)",
+                          cxxopts::value<std::size_t>());
+    options.add_options()("publish",
+                          "publish the output to any number of subscribers via the specified unix domain socket "
+                          "instead of writing it to stdout.",
+                          cxxopts::value<std::string>());
+    options.add_options()("publish-queue",
+                          "number of cycles that are buffered for each subscriber. (default: " +
+                                  std::to_string(DEFAULT_PUBLISH_QUEUE) + ')',
+                          cxxopts::value<std::size_t>());
+    options.add_options()("slow-consumer",
+                          "what to do with subscribers that fall behind more than --publish-queue cycles: "
+                          "disconnect (default) or drop (skip the oldest cycles)",
+                          cxxopts::value<std::string>());
+    options.add_options()("no-vmsplice",
+                          "do not use vmsplice if stdout is a pipe (use this if the consumer uses splice to move the "
+                          "data out of the pipe)");
     options.add_options()("h,help", "Show usage information");
     options.add_options()("version", "print version information");
     options.add_options()("license", "show licences");
@@ -133,46 +351,522 @@ int main(int argc, char **argv) {
         term_handler.establish();
         quit_handler.establish();
         timer_handler.establish();
+        if (opts.count("capture")) {
+            trigger_handler = std::make_unique<TriggerHandler>(SIGUSR2);
+            trigger_handler->establish();
+        }
+        if (opts.count("profile-changes")) {
+            report_handler = std::make_unique<ReportHandler>(SIGUSR1);
+            report_handler->establish();
+        }
     } catch (const std::system_error &e) {
         std::cerr << "Failed to establish signal handler: " << e.what() << std::endl;
         return EX_OSERR;
     }
 
+    float_format_t float_format = float_format_t::scientific;
+    if (opts.count("float-format")) {
+        try {
+            float_format = str_to_float_format(opts["float-format"].as<std::string>());
+        } catch (const std::exception &e) {
+            std::cerr << "failed to parse float format: " << e.what() << std::endl;
+            return exit_usage();
+        }
+    }
+
+    std::size_t keyframe_ms     = 0;
+    std::size_t keyframe_spread = 1;
+    try {
+        if (opts.count("keyframe")) keyframe_ms = opts["keyframe"].as<std::size_t>();
+        if (opts.count("keyframe-spread")) keyframe_spread = opts["keyframe-spread"].as<std::size_t>();
+    } catch (const std::exception &e) {
+        std::cerr << "failed to parse keyframe options: " << e.what() << std::endl;
+        return exit_usage();
+    }
+
+    if (keyframe_spread == 0) {
+        std::cerr << "invalid keyframe spread" << std::endl;
+        return exit_usage();
+    }
+
+    std::size_t aggregate_ms = 0;
+    try {
+        if (opts.count("aggregate")) aggregate_ms = opts["aggregate"].as<std::size_t>();
+    } catch (const std::exception &e) {
+        std::cerr << "failed to parse aggregation window: " << e.what() << std::endl;
+        return exit_usage();
+    }
+
+    if (opts.count("aggregate") && (aggregate_ms == 0 || EVENT_MODE || SINGLE_MODE)) {
+        std::cerr << "invalid aggregation window or aggregation combined with event or single mode" << std::endl;
+        return exit_usage();
+    }
+
+    std::size_t capture_ms      = 0;
+    std::size_t capture_post_ms = 0;
+    try {
+        if (opts.count("capture")) capture_ms = opts["capture"].as<std::size_t>();
+        if (opts.count("capture-post")) capture_post_ms = opts["capture-post"].as<std::size_t>();
+    } catch (const std::exception &e) {
+        std::cerr << "failed to parse capture options: " << e.what() << std::endl;
+        return exit_usage();
+    }
+
+    if (opts.count("capture") && (capture_ms == 0 || EVENT_MODE || SINGLE_MODE || aggregate_ms)) {
+        std::cerr << "invalid capture time or capture combined with event, single or aggregation mode" << std::endl;
+        return exit_usage();
+    }
+
+    std::size_t           threads    = 1;
+    std::size_t           chunk_size = DEFAULT_CHUNK_SIZE;
+    CyclicOut::schedule_t schedule   = CyclicOut::schedule_t::static_chunks;
+    try {
+        if (opts.count("threads")) threads = opts["threads"].as<std::size_t>();
+        if (opts.count("chunk-size")) chunk_size = opts["chunk-size"].as<std::size_t>();
+        if (opts.count("schedule")) {
+            const auto str = opts["schedule"].as<std::string>();
+            if (str == "dynamic") schedule = CyclicOut::schedule_t::work_stealing;
+            else if (str != "static")
+                throw std::runtime_error("unknown schedule '" + str + '\'');
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "failed to parse thread options: " << e.what() << std::endl;
+        return exit_usage();
+    }
+
+    if (threads == 0 || chunk_size == 0) {
+        std::cerr << "invalid number of threads or chunk size" << std::endl;
+        return exit_usage();
+    }
+
+    std::size_t rotate_size = 0;
+    std::size_t rotate_time = 0;
+    try {
+        if (opts.count("rotate-size")) rotate_size = opts["rotate-size"].as<std::size_t>();
+        if (opts.count("rotate-time")) rotate_time = opts["rotate-time"].as<std::size_t>();
+    } catch (const std::exception &e) {
+        std::cerr << "failed to parse rotation: " << e.what() << std::endl;
+        return exit_usage();
+    }
+
+    if ((rotate_size || rotate_time) && !opts.count("output")) {
+        std::cerr << "file rotation requires --output" << std::endl;
+        return exit_usage();
+    }
+
+    if (opts.count("profile-changes") && !EVENT_MODE) {
+        std::cerr << "--profile-changes requires event mode" << std::endl;
+        return exit_usage();
+    }
+
+    std::size_t event_ring_size = DEFAULT_EVENT_RING;
+    try {
+        if (opts.count("event-ring-size")) event_ring_size = opts["event-ring-size"].as<std::size_t>();
+    } catch (const std::exception &e) {
+        std::cerr << "failed to parse event ring size: " << e.what() << std::endl;
+        return exit_usage();
+    }
+
+    if (opts.count("state-file") && (!EVENT_MODE || SINGLE_MODE)) {
+        std::cerr << "--state-file requires event mode" << std::endl;
+        return exit_usage();
+    }
+
+    if (opts.count("event-ring") && (!EVENT_MODE || SINGLE_MODE)) {
+        std::cerr << "--event-ring requires event mode" << std::endl;
+        return exit_usage();
+    }
+
+    if (opts.count("event-ring-size") && !opts.count("event-ring")) {
+        std::cerr << "--event-ring-size requires --event-ring" << std::endl;
+        return exit_usage();
+    }
+
+    if (opts.count("influx-tags") && !opts.count("influx")) {
+        std::cerr << "--influx-tags requires --influx" << std::endl;
+        return exit_usage();
+    }
+
+    if (opts.count("output") && opts.count("publish")) {
+        std::cerr << "--output and --publish can not be combined" << std::endl;
+        return exit_usage();
+    }
+
+    std::size_t publish_queue = DEFAULT_PUBLISH_QUEUE;
+    auto        slow_consumer = SocketPublisher::slow_consumer_policy_t::disconnect;
+    try {
+        if (opts.count("publish-queue")) publish_queue = opts["publish-queue"].as<std::size_t>();
+        if (opts.count("slow-consumer")) {
+            const auto policy = opts["slow-consumer"].as<std::string>();
+            if (policy == "disconnect") slow_consumer = SocketPublisher::slow_consumer_policy_t::disconnect;
+            else if (policy == "drop")
+                slow_consumer = SocketPublisher::slow_consumer_policy_t::drop;
+            else
+                throw std::runtime_error("unknown slow consumer policy '" + policy + '\'');
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "failed to parse publish options: " << e.what() << std::endl;
+        return exit_usage();
+    }
+
+    std::unique_ptr<std::streambuf> output_buf;
+    std::unique_ptr<std::ostream>   output_stream;
+    std::ostream                   *output = &std::cout;
+    if (opts.count("output")) {
+        try {
+            output_buf = std::make_unique<FileSink>(
+                    opts["output"].as<std::string>(), rotate_size, std::chrono::seconds(rotate_time));
+        } catch (const std::exception &e) {
+            std::cerr << "failed to open output file: " << e.what() << std::endl;
+            return EX_CANTCREAT;
+        }
+    } else if (opts.count("publish")) {
+        try {
+            output_buf = std::make_unique<SocketPublisher>(
+                    opts["publish"].as<std::string>(), publish_queue, slow_consumer);
+        } catch (const std::exception &e) {
+            std::cerr << "failed to create publisher socket: " << e.what() << std::endl;
+            return EX_CANTCREAT;
+        }
+    } else if (!opts.count("no-vmsplice") && StdoutSink::is_pipe(STDOUT_FILENO)) {
+        try {
+            output_buf = std::make_unique<StdoutSink>(STDOUT_FILENO, DEFAULT_PIPE_SIZE);
+        } catch (const std::exception &e) {
+            std::cerr << "failed to create output buffer: " << e.what() << std::endl;
+            return EX_OSERR;
+        }
+    }
+    if (output_buf) {
+        output_stream = std::make_unique<std::ostream>(output_buf.get());
+        output        = output_stream.get();
+    }
+
+    if (opts.count("read-archive")) {
+        try {
+            ArchiveReader reader(opts["read-archive"].as<std::string>());
+            if (!reader.indexed())
+                std::cerr << "WARNING: archive was not closed properly (no block index)" << std::endl;
+
+            int64_t from_us = std::numeric_limits<int64_t>::min();
+            if (opts.count("read-from")) from_us = static_cast<int64_t>(opts["read-from"].as<double>() * 1e6);
+            reader.print(*output, from_us);
+            output->flush();
+        } catch (const std::exception &e) {
+            std::cerr << "failed to read archive: " << e.what() << std::endl;
+            return EX_DATAERR;
+        }
+        return EX_OK;
+    }
+
+    std::size_t archive_block = DEFAULT_ARCHIVE_BLOCK;
+    try {
+        if (opts.count("archive-block")) archive_block = opts["archive-block"].as<std::size_t>();
+    } catch (const std::exception &e) {
+        std::cerr << "failed to parse archive options: " << e.what() << std::endl;
+        return exit_usage();
+    }
+
     std::string file;
     if (opts["file"].count()) file = opts["file"].as<std::string>();
 
+    bool                    replay_fast = false;
+    std::unique_ptr<Replay> replay;
+    bool                    replay_pending  = false;  // the current record is loaded, but not yet processed
+    int64_t                 replay_first_ts = 0;
+    std::string             name_prefix     = "modbus_";
+    if (opts.count("replay")) {
+        const auto speed = opts["replay-speed"].as<std::string>();
+        if (speed == "fast") replay_fast = true;
+        else if (speed != "recorded") {
+            std::cerr << "unknown replay speed '" << speed << '\'' << std::endl;
+            return exit_usage();
+        }
+
+        if (opts.count("record") || opts.count("notify")) {
+            std::cerr << "--replay can not be combined with --record or --notify" << std::endl;
+            return exit_usage();
+        }
+
+        try {
+            replay = std::make_unique<Replay>(opts["replay"].as<std::string>());
+
+            // load the first record before the outputs, triggers and conditions are created: they take their initial
+            // state (e.g. the event mode shadow) from the shared memories
+            replay_pending = replay->next(replay_first_ts);
+        } catch (const std::exception &e) {
+            std::cerr << "failed to open recording: " << e.what() << std::endl;
+            return EX_NOINPUT;
+        }
+        name_prefix = replay->name_prefix();
+    }
+
     std::shared_ptr<MbOut> init_out;
     std::shared_ptr<MbOut> mb_out;
     try {
-        init_out = std::make_shared<CyclicOut>(file, std::cout);
-        if (EVENT_MODE) {
-            mb_out = std::make_shared<EventOut>(file, std::cout);
+        auto cyclic_out = std::make_shared<CyclicOut>(file, *output, name_prefix, float_format);
+        if (threads > 1) cyclic_out->set_parallel(threads, chunk_size, schedule);
+        init_out = cyclic_out;
+        if (opts.count("serve")) {
+            if (EVENT_MODE || SINGLE_MODE || aggregate_ms || capture_ms || opts.count("shm-table") ||
+                opts.count("record") || opts.count("archive") || replay)
+                throw std::runtime_error("--serve can not be combined with other output modes or --replay");
+
+            std::vector<std::pair<std::string, std::string>> signal_sets;
+            if (opts.count("signal-set")) {
+                for (const auto &spec : opts["signal-set"].as<std::vector<std::string>>()) {
+                    const auto separator = spec.find('=');
+                    if (separator == std::string::npos)
+                        throw std::runtime_error("invalid signal set '" + spec + "' (expected: NAME=SIGNAL_LIST)");
+                    signal_sets.emplace_back(spec.substr(0, separator), spec.substr(separator + 1));
+                }
+            }
+
+            mb_out   = std::make_shared<QueryServer>(
+                    file, *output, opts["serve"].as<std::string>(), signal_sets, name_prefix, float_format);
+            init_out = mb_out;
+        } else if (opts.count("record")) {
+            if (EVENT_MODE || SINGLE_MODE || aggregate_ms || capture_ms || opts.count("shm-table") ||
+                opts.count("archive"))
+                throw std::runtime_error("--record can not be combined with event, single, aggregation, capture, "
+                                         "archive or shared memory table mode");
+            mb_out   = std::make_shared<RecordOut>(file, *output, opts["record"].as<std::string>(), name_prefix);
+            init_out = mb_out;
+        } else if (opts.count("archive")) {
+            if (EVENT_MODE || SINGLE_MODE || aggregate_ms || capture_ms || opts.count("shm-table"))
+                throw std::runtime_error("--archive can not be combined with event, single, aggregation, capture or "
+                                         "shared memory table mode");
+            mb_out   = std::make_shared<ArchiveOut>(
+                    file, *output, opts["archive"].as<std::string>(), archive_block, name_prefix, float_format);
+            init_out = mb_out;
+        } else if (opts.count("shm-table")) {
+            if (EVENT_MODE || SINGLE_MODE || aggregate_ms || capture_ms)
+                throw std::runtime_error("--shm-table can not be combined with event, single, aggregation or capture "
+                                         "mode");
+            mb_out = std::make_shared<ShmTableOut>(file, *output, opts["shm-table"].as<std::string>(), name_prefix);
+            init_out = mb_out;
+        } else if (capture_ms) {
+            auto capture_out = std::make_shared<CaptureOut>(file,
+                                                            *output,
+                                                            std::max<std::size_t>(capture_ms / cycle_ms, 1),
+                                                            capture_post_ms / cycle_ms,
+                                                            name_prefix,
+                                                            float_format);
+            if (opts.count("trigger"))
+                for (const auto &spec : opts["trigger"].as<std::vector<std::string>>())
+                    capture_out->add_edge_trigger(spec);
+            if (opts.count("trigger-condition"))
+                for (const auto &expr : opts["trigger-condition"].as<std::vector<std::string>>())
+                    capture_out->add_condition_trigger(std::make_unique<Expression>(expr, name_prefix));
+            mb_out   = capture_out;
+            init_out = mb_out;
+        } else if (aggregate_ms) {
+            // the first cycle is already a sample of the first window
+            mb_out   = std::make_shared<AggregateOut>(file,
+                                                    *output,
+                                                    std::max<std::size_t>(aggregate_ms / cycle_ms, 1),
+                                                    name_prefix,
+                                                    float_format);
+            init_out = mb_out;
+        } else if (EVENT_MODE) {
+            auto event_out = std::make_shared<EventOut>(file, *output, name_prefix, float_format);
+            if (keyframe_ms) event_out->set_keyframes(keyframe_ms, keyframe_spread);
+            event_out->set_coil_groups(opts.count("coil-groups") != 0);
+            if (opts.count("profile-changes")) event_out->enable_profile();
+            if (opts.count("state-file")) {
+                const auto path   = opts["state-file"].as<std::string>();
+                const auto status = event_out->set_state_file(path);
+                if (status == StateFile::status_t::mismatch)
+                    std::cerr << "WARNING: state file '" << path << "' does not match the signal list (discarded)"
+                              << std::endl;
+                if (status == StateFile::status_t::interrupted)
+                    std::cerr << "WARNING: state file '" << path << "' was not written completely (discarded)"
+                              << std::endl;
+
+                // the stored state is the last output state: output only the differences
+                if (status == StateFile::status_t::loaded) init_out = event_out;
+            }
+            if (opts.count("event-ring")) {
+                if (opts.count("coil-groups"))
+                    throw std::runtime_error("--event-ring can not be combined with --coil-groups");
+                if (opts.count("influx")) throw std::runtime_error("--event-ring can not be combined with --influx");
+
+                // the ring starts with a keyframe: no initial text output
+                event_out->set_event_ring(opts["event-ring"].as<std::string>(), event_ring_size);
+                init_out = event_out;
+            }
+            mb_out = event_out;
         } else {
             mb_out = init_out;
         }
+
+        if (opts.count("influx")) {
+            if (opts.count("serve") || opts.count("record") || opts.count("archive") || opts.count("shm-table") ||
+                capture_ms || aggregate_ms)
+                throw std::runtime_error("--influx is only available in cyclic, single and event mode");
+            if (opts.count("coil-groups")) throw std::runtime_error("--influx can not be combined with --coil-groups");
+
+            const auto measurement = opts["influx"].as<std::string>();
+            const auto tags        = opts.count("influx-tags") ? opts["influx-tags"].as<std::string>() : std::string();
+            init_out->set_influx(measurement, tags);
+            if (mb_out != init_out) mb_out->set_influx(measurement, tags);
+        }
     } catch (const std::exception &e) {
         std::cerr << e.what() << std::endl;
         return EX_DATAERR;
     }
 
+    std::unique_ptr<Expression> condition;
+    if (opts.count("condition")) {
+        try {
+            condition = std::make_unique<Expression>(opts["condition"].as<std::string>(), name_prefix);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return EX_DATAERR;
+        }
+    }
+
+    // the condition suppresses the complete cycle (no decoding and formatting) if it is false
+    // (it reads the shared memory separately from the cycle, see Expression)
+    auto cycle = [&condition](MbOut &out) {
+        if (!condition || condition->evaluate()) out.cycle();
+    };
+
+    if (opts.count("realtime")) {
+        realtime_profile_t profile;
+        try {
+            if (opts.count("rt-cpu")) profile.cpu = opts["rt-cpu"].as<int>();
+            if (opts.count("rt-priority")) profile.priority = opts["rt-priority"].as<int>();
+        } catch (const std::exception &e) {
+            std::cerr << "failed to parse real time options: " << e.what() << std::endl;
+            return exit_usage();
+        }
+
+        init_out->prefault();
+        mb_out->prefault();
+        for (const auto &failed : apply_realtime_profile(profile))
+            std::cerr << "WARNING: real time profile: " << failed << std::endl;
+        if (profile.cpu >= 0 && threads > 1)
+            std::cerr << "WARNING: real time profile: worker threads (--threads) are pinned to the same cpu"
+                      << std::endl;
+    }
+
+    std::unique_ptr<ChangeNotifier> notifier;
+    if (opts.count("notify")) {
+        if (!EVENT_MODE) {
+            std::cerr << "--notify requires event mode" << std::endl;
+            return exit_usage();
+        }
+
+        try {
+            notifier = std::make_unique<ChangeNotifier>(name_prefix + "notify");
+        } catch (const std::exception &e) {
+            std::cerr << "WARNING: change notification not available (" << e.what() << "). Polling every "
+                      << cycle_ms << " ms." << std::endl;
+        }
+    }
+
+    // query daemon: requests are answered immediately, there is no cycle
+    if (auto server = std::dynamic_pointer_cast<QueryServer>(mb_out)) {
+        try {
+            while (!TerminateHandler::terminate()) {
+                server->wait(-1);
+                server->cycle();
+            }
+        } catch (const std::exception &e) {
+            if (!TerminateHandler::terminate()) {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+                return EX_OSERR;
+            }
+        }
+        return EX_OK;
+    }
+
+    // signal groups with individual cycle times
+    std::shared_ptr<CyclicOut> group_out;
+    if (mb_out->has_signal_groups() && !SINGLE_MODE) {
+        group_out = std::dynamic_pointer_cast<CyclicOut>(mb_out);
+        if (!group_out || threads > 1) {
+            std::cerr << "@cycle directives are only supported in cyclic mode without --threads" << std::endl;
+            return exit_usage();
+        }
+        group_out->schedule_groups(cycle_ms);
+    }
+
+    // change statistics (no output if the profile is not enabled)
+    const auto profile_out = std::dynamic_pointer_cast<EventOut>(mb_out);
+    auto       report      = [&profile_out](bool requested) {
+        if (profile_out && requested) profile_out->report_profile(std::cerr);
+    };
+
+    if (replay) {
+        // one cycle per record; the first record is the initial cycle
+        const auto start   = std::chrono::steady_clock::now();
+        int64_t    ts      = replay_first_ts;
+        uint64_t   records = 0;
+        try {
+            while (!TerminateHandler::terminate() && replay_pending) {
+                if (records != 0 && !replay_fast)
+                    std::this_thread::sleep_until(start + std::chrono::nanoseconds(ts - replay_first_ts));
+
+                if (TriggerHandler::triggered()) {
+                    if (auto capture_out = std::dynamic_pointer_cast<CaptureOut>(mb_out))
+                        capture_out->trigger("signal");
+                }
+                cycle(records == 0 ? *init_out : *mb_out);
+                ++records;
+                if (SINGLE_MODE) break;
+                report(ReportHandler::requested());
+                replay_pending = replay->next(ts);
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "ERROR: " << e.what() << std::endl;
+            return EX_OSERR;
+        }
+        report(true);
+
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "replayed " << records << " of " << replay->records() << " records in " << elapsed << " s ("
+                  << static_cast<double>(records) / elapsed << " records/s)" << std::endl;
+        return EX_OK;
+    }
+
+    // signal groups: sleep until the next group is due instead of a fixed timer
+    if (group_out) {
+        if (TerminateHandler::terminate()) return EX_OK;
+        cycle(*init_out);
+        while (!TerminateHandler::terminate()) {
+            // interrupted by a signal: check for termination
+            if (!group_out->wait_groups()) continue;
+            cycle(*mb_out);
+        }
+        return EX_OK;
+    }
+
     cxxitimer::ITimer_Real timer(static_cast<double>(cycle_ms) / 1000.0);
-    timer.start();
+    if (!notifier) timer.start();
 
     if (!TerminateHandler::terminate() && !SINGLE_MODE) {
-        init_out->cycle();
+        cycle(*init_out);
 
         do {
             try {
-                timer_handler._wait();
+                if (notifier) notifier->wait(std::chrono::milliseconds(cycle_ms));
+                else
+                    timer_handler._wait();
             } catch (const std::exception &e) {
                 if (TerminateHandler::terminate()) break;
                 std::cerr << "ERROR: " << e.what() << std::endl;
                 return EX_OSERR;
             }
 
-            mb_out->cycle();
+            if (TriggerHandler::triggered()) {
+                if (auto capture_out = std::dynamic_pointer_cast<CaptureOut>(mb_out)) capture_out->trigger("signal");
+            }
+            cycle(*mb_out);
+            report(ReportHandler::requested());
         } while (!TerminateHandler::terminate());
+        report(true);
     } else if (SINGLE_MODE) {
-        init_out->cycle();
+        cycle(*init_out);
     }
 }
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "realtime.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/** size of the stack area that is prefaulted */
+static constexpr std::size_t PREFAULT_STACK_SIZE = 256 * 1024;
+
+static std::string error_str(const char *what, int err) {
+    return std::string(what) + ": " + strerror(err);
+}
+
+static void prefault_stack() {
+    volatile char stack[PREFAULT_STACK_SIZE];
+    const auto    page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    for (std::size_t i = 0; i < sizeof(stack); i += page_size)
+        stack[i] = 0;
+}
+
+void prefault_memory(const void *addr, std::size_t size) {
+    if (!size) return;
+
+    const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const auto begin     = reinterpret_cast<uintptr_t>(addr) / page_size * page_size;
+    madvise(reinterpret_cast<void *>(begin), reinterpret_cast<uintptr_t>(addr) + size - begin, MADV_WILLNEED);
+
+    // read access is sufficient to map the page (also works for read only mappings)
+    const auto *p = static_cast<const volatile char *>(addr);
+    for (std::size_t i = 0; i < size; i += page_size)
+        static_cast<void>(p[i]);
+    static_cast<void>(p[size - 1]);
+}
+
+std::vector<std::string> apply_realtime_profile(const realtime_profile_t &profile) {
+    std::vector<std::string> failed;
+
+    // freed memory stays in the process: later allocations do not cause page faults
+    if (!mallopt(M_TRIM_THRESHOLD, -1)) failed.emplace_back("mallopt(M_TRIM_THRESHOLD) failed");
+    if (!mallopt(M_MMAP_MAX, 0)) failed.emplace_back("mallopt(M_MMAP_MAX) failed");
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) failed.emplace_back(error_str("mlockall", errno));
+
+    prefault_stack();
+
+    if (profile.cpu >= 0) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(static_cast<std::size_t>(profile.cpu), &cpu_set);
+        const int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        if (err) failed.emplace_back(error_str(("cpu pinning (cpu " + std::to_string(profile.cpu) + ')').c_str(), err));
+    }
+
+    sched_param param {};
+    param.sched_priority = profile.priority;
+    const int err        = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err)
+        failed.emplace_back(
+                error_str(("SCHED_FIFO (priority " + std::to_string(profile.priority) + ')').c_str(), err));
+
+    return failed;
+}
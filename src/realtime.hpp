@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct realtime_profile_t {
+    int cpu      = -1; /**< pin the calling thread to this cpu (-1: no pinning) */
+    int priority = 50; /**< SCHED_FIFO priority */
+};
+
+/**
+ * \brief apply the real time profile to the calling thread (and the process)
+ *
+ * - keep freed heap memory in the process (no trimming, no mmap for large allocations)
+ * - lock all current and future memory (mlockall)
+ * - prefault the stack
+ * - pin the calling thread to the configured cpu
+ * - SCHED_FIFO with the configured priority for the calling thread
+ *
+ * Threads that already exist are not affected by the cpu pinning and the scheduling policy.
+ *
+ * @param profile real time profile
+ * @return descriptions of the parts of the profile that could not be applied
+ */
+std::vector<std::string> apply_realtime_profile(const realtime_profile_t &profile);
+
+/**
+ * \brief touch each page of a memory area, so that no page faults occur later
+ * @param addr start of the memory area
+ * @param size size of the memory area
+ */
+void prefault_memory(const void *addr, std::size_t size);
@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <cerrno>
+
+/**
+ * \brief check if an error code of a non blocking operation means "try again later"
+ *
+ * EAGAIN and EWOULDBLOCK have the same value on most platforms (comparing with both is a logical-op warning).
+ *
+ * @param err error code (errno)
+ * @return true if err is EAGAIN or EWOULDBLOCK
+ */
+[[nodiscard]] static inline bool would_block(int err) {
+#if EAGAIN != EWOULDBLOCK
+    return err == EAGAIN || err == EWOULDBLOCK;
+#else
+    return err == EAGAIN;
+#endif
+}
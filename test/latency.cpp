@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2022 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+/*
+ * Stimulus generator and latency measurement for modbus-shm-to-stdout.
+ *
+ * Creates the modbus_* shared memories (and modbus_notify), starts the application with the given arguments and a
+ * generated signal list, writes a pattern and evaluates the output of the application:
+ *  - ao:0:u32l  sequence number of the last change (written after the pattern signal)
+ *  - do:0       toggled by the patterns toggle and burst
+ *  - ao:2:u16l  incremented by the pattern ramp
+ *
+ * The latency of a change is the time between writing the sequence number and reading the first output line that
+ * contains it. Changes whose sequence number is never output are counted as missed.
+ *
+ * usage: latency_modbus-shm-to-stdout [-p toggle|ramp|burst] [-r RATE] [-d SECONDS] [-b BURST] [-g GAP_US]
+ *                                     -- APPLICATION [ARGS...]
+ */
+
+#include "ChangeNotifier.hpp"
+
+#include "cxxshm.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <poll.h>
+#include <signal.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+static constexpr int64_t NS_PER_S = 1000000000;
+
+static int64_t now_ns() {
+    timespec ts {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+/** \brief description of a wait status */
+static std::string describe_status(int status) {
+    if (WIFEXITED(status)) return "exit status " + std::to_string(WEXITSTATUS(status));
+    if (WIFSIGNALED(status)) return std::string("signal ") + strsignal(WTERMSIG(status));
+    return "status " + std::to_string(status);
+}
+
+static void usage(const char *name) {
+    std::cerr << "usage: " << name
+              << " [-p toggle|ramp|burst] [-r RATE] [-d SECONDS] [-b BURST] [-g GAP_US] -- APPLICATION [ARGS...]\n"
+                 "  -p  pattern (default: toggle)\n"
+                 "  -r  changes (bursts) per second (default: 100)\n"
+                 "  -d  duration in seconds (default: 5)\n"
+                 "  -b  changes per burst (default: 10)\n"
+                 "  -g  time between the changes of a burst in us (default: 50)\n";
+}
+
+/** reads the output of the application and assigns a receive time to each sequence number */
+class OutputReader {
+private:
+    int                   fd;
+    std::string           line;
+    std::vector<int64_t> &received;  // receive time per sequence number (0: not received)
+    uint64_t              pattern_lines = 0;
+
+public:
+    OutputReader(int fd, std::vector<int64_t> &received) : fd(fd), received(received) {}
+
+    /** \brief read the available output; returns false at the end of the output */
+    bool read() {
+        char       buffer[4096];
+        const auto ret = ::read(fd, buffer, sizeof(buffer));
+        if (ret < 0) return errno == EINTR;
+        if (ret == 0) return false;
+
+        const auto time = now_ns();
+        for (ssize_t i = 0; i < ret; ++i) {
+            if (buffer[i] != '\n') {
+                line += buffer[i];
+                continue;
+            }
+
+            static constexpr const char SEQUENCE[] = "ao:0:u32l:";
+            if (line.compare(0, sizeof(SEQUENCE) - 1, SEQUENCE) == 0) {
+                const auto seq = std::strtoull(line.c_str() + sizeof(SEQUENCE) - 1, nullptr, 10);
+                if (seq < received.size() && received[seq] == 0) received[seq] = time;
+            } else if (line.compare(0, 5, "do:0:") == 0 || line.compare(0, 10, "ao:2:u16l:") == 0) {
+                ++pattern_lines;
+            }
+            line.clear();
+        }
+        return true;
+    }
+
+    /** \brief read output until the specified time; returns false if the output was closed before */
+    bool read_until(int64_t time) {
+        for (;;) {
+            const auto remaining = time - now_ns();
+            if (remaining <= 0) return true;
+
+            pollfd   pfd {fd, POLLIN, 0};
+            timespec timeout {remaining / NS_PER_S, remaining % NS_PER_S};
+            const auto ret = ppoll(&pfd, 1, &timeout, nullptr);
+            if (ret > 0 && !read()) return false;
+        }
+    }
+
+    [[nodiscard]] uint64_t get_pattern_lines() const { return pattern_lines; }
+};
+
+int main(int argc, char **argv) {
+    std::string pattern  = "toggle";
+    double      rate     = 100;
+    double      duration = 5;
+    long        burst    = 10;
+    long        gap_us   = 50;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+p:r:d:b:g:h")) != -1) {
+        switch (opt) {
+            case 'p': pattern = optarg; break;
+            case 'r': rate = std::strtod(optarg, nullptr); break;
+            case 'd': duration = std::strtod(optarg, nullptr); break;
+            case 'b': burst = std::strtol(optarg, nullptr, 0); break;
+            case 'g': gap_us = std::strtol(optarg, nullptr, 0); break;
+            default: usage(argv[0]); return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (optind == argc || rate <= 0 || duration <= 0 || burst < 1 || gap_us < 0 ||
+        (pattern != "toggle" && pattern != "ramp" && pattern != "burst")) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // create shared memories
+    cxxshm::SharedMemory shm_ao("modbus_AO", 4096, false, true);
+    cxxshm::SharedMemory shm_ai("modbus_AI", 4096, false, true);
+    cxxshm::SharedMemory shm_do("modbus_DO", 4096, false, true);
+    cxxshm::SharedMemory shm_di("modbus_DI", 4096, false, true);
+    cxxshm::SharedMemory shm_notify("modbus_notify", 64, false, true);
+
+    char signal_list[] = "/tmp/latency_signals_XXXXXX";
+    {
+        const int fd = mkstemp(signal_list);
+        if (fd < 0) {
+            perror("mkstemp");
+            return EXIT_FAILURE;
+        }
+        static constexpr char SIGNALS[] = "ao:0:u32l\ndo:0\nao:2:u16l\n";
+        if (write(fd, SIGNALS, sizeof(SIGNALS) - 1) != sizeof(SIGNALS) - 1) {
+            perror("write");
+            return EXIT_FAILURE;
+        }
+        close(fd);
+    }
+
+    int pipe_fds[2];
+    if (pipe(pipe_fds)) {
+        perror("pipe");
+        return EXIT_FAILURE;
+    }
+
+    const auto  started = now_ns();
+    const pid_t pid     = fork();
+    if (pid < 0) {
+        perror("fork");
+        return EXIT_FAILURE;
+    }
+    if (pid == 0) {
+        dup2(pipe_fds[1], STDOUT_FILENO);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+
+        std::vector<char *> args(argv + optind, argv + argc);
+        args.push_back(signal_list);
+        args.push_back(nullptr);
+        execvp(args[0], args.data());
+        perror("execvp");
+        _exit(EXIT_FAILURE);
+    }
+    close(pipe_fds[1]);
+
+    const auto changes_per_event = pattern == "burst" ? static_cast<std::size_t>(burst) : std::size_t {1};
+    const auto events            = static_cast<std::size_t>(rate * duration);
+    const auto changes           = events * changes_per_event;
+
+    std::vector<int64_t> written(changes + 1, 0);
+    std::vector<int64_t> received(changes + 1, 0);
+    OutputReader         reader(pipe_fds[0], received);
+
+    auto *sequence   = shm_ao.get_addr<uint32_t *>();
+    auto *ramp       = shm_ao.get_addr<uint16_t *>() + 2;
+    auto *coil       = shm_do.get_addr<uint8_t *>();
+
+    ChangeNotifier notifier("modbus_notify");  // writer side of --notify
+
+    auto change = [&](uint32_t seq) {
+        if (pattern == "ramp") __atomic_store_n(ramp, static_cast<uint16_t>(*ramp + 1), __ATOMIC_RELAXED);
+        else
+            __atomic_store_n(coil, static_cast<uint8_t>(!*coil), __ATOMIC_RELAXED);
+        written[seq] = now_ns();
+        __atomic_store_n(sequence, seq, __ATOMIC_RELEASE);
+        notifier.notify();
+    };
+
+    // startup of the application (initial output)
+    // running: false if the output was closed (the application exited), the run is stopped
+    bool running = reader.read_until(now_ns() + NS_PER_S / 2);
+
+    const auto period = static_cast<int64_t>(static_cast<double>(NS_PER_S) / rate);
+    const auto start  = now_ns();
+    uint32_t   seq    = 0;
+    for (std::size_t event = 0; running && event < events; ++event) {
+        running = reader.read_until(start + static_cast<int64_t>(event) * period);
+        for (std::size_t i = 0; running && i < changes_per_event; ++i) {
+            if (i) running = reader.read_until(now_ns() + gap_us * 1000);
+            if (running) change(++seq);
+        }
+    }
+    const auto end = now_ns();
+
+    if (running) {
+        // the application gets time for the output of the last change
+        running = reader.read_until(end + NS_PER_S / 2);
+        kill(pid, SIGINT);
+        while (reader.read()) {}
+    }
+    int status;
+    rusage usage {};
+    wait4(pid, &status, 0, &usage);
+    const auto stopped = now_ns();
+    close(pipe_fds[0]);
+    unlink(signal_list);
+
+    if (!running) {
+        std::cerr << "application exited after " << seq << " of " << changes << " changes ("
+                  << describe_status(status) << ")" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // evaluation
+    std::vector<int64_t> latencies;
+    for (std::size_t i = 1; i <= changes; ++i)
+        if (received[i]) latencies.push_back(received[i] - written[i]);
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&latencies](double p) {
+        const auto idx = static_cast<std::size_t>(p / 100.0 * static_cast<double>(latencies.size() - 1) + 0.5);
+        return static_cast<double>(latencies[idx]) / 1000.0;
+    };
+
+    const auto missed = changes - latencies.size();
+    printf("pattern:          %s, %g/s, %zu change(s) per event\n", pattern.c_str(), rate, changes_per_event);
+    printf("changes written:  %zu\n", changes);
+    printf("changes seen:     %zu (missed: %zu, %.2f %%)\n",
+           latencies.size(),
+           missed,
+           changes ? 100.0 * static_cast<double>(missed) / static_cast<double>(changes) : 0.0);
+    printf("pattern lines:    %llu\n", static_cast<unsigned long long>(reader.get_pattern_lines()));
+    if (!latencies.empty()) {
+        printf("latency [us]:     min %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+               percentile(0),
+               percentile(50),
+               percentile(90),
+               percentile(99),
+               percentile(99.9),
+               percentile(100));
+    }
+
+    // cpu time of the application over its complete run time (including startup and termination)
+    const auto cpu = [](const timeval &tv) {
+        return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+    };
+    const auto user   = cpu(usage.ru_utime);
+    const auto system = cpu(usage.ru_stime);
+    const auto wall   = static_cast<double>(stopped - started) / 1e9;
+    printf("cpu [s]:          user %.3f, system %.3f (%.2f %% of one core during %.1f s)\n",
+           user,
+           system,
+           100.0 * (user + system) / wall,
+           wall);
+
+    if (!WIFEXITED(status) && !(WIFSIGNALED(status) && WTERMSIG(status) == SIGINT)) {
+        std::cerr << "application terminated abnormally" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -3,12 +3,37 @@
  * This template is free software. You can redistribute it and/or modify it under the terms of the MIT License.
  */
 
+#include "ArchiveOut.hpp"
+#include "ChangeNotifier.hpp"
+#include "EventRing.hpp"
+#include "FileSink.hpp"
+#include "StateFile.hpp"
+
 #include "cxxshm.hpp"
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sysexits.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
 
 static std::pair<std::string, int> exec(const char *cmd) {
     std::array<char, 4096> buffer {};
@@ -29,6 +54,60 @@ static std::pair<std::string, int> exec(const char *cmd) {
     return {result, exit_code};
 }
 
+/** \brief write a file (e.g. a signal list) to the working directory */
+static void write_file(const std::string &name, const std::string &content) {
+    std::ofstream file(name, std::ios::trunc);
+    file << content;
+}
+
+/**
+ * \brief check exit code and output of a test
+ * @return false if the result does not match (error message is printed)
+ */
+static bool check(const std::string                 &test,
+                  const std::pair<std::string, int> &result,
+                  int                                exit_code,
+                  const std::string                 &output) {
+    if (!WIFEXITED(result.second) || WEXITSTATUS(result.second) != exit_code) {
+        std::cerr << test << ": wrong exit code" << std::endl;
+        return false;
+    }
+
+    if (result.first != output) {
+        std::cerr << test << ": wrong output: >>" << result.first << "<<" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief encode values with an archive column encoder and decode them again
+ * @return true if all values are decoded unchanged
+ */
+template <typename Decoder, typename Encoder, typename T, typename... DecoderArgs>
+static bool archive_round_trip(Encoder encoder, const std::vector<T> &values, DecoderArgs... decoder_args) {
+    for (const auto value : values)
+        encoder.add(value);
+    const auto &bytes = encoder.finish().bytes();
+
+    Decoder decoder(bytes.data(), bytes.size(), decoder_args...);
+    for (const auto value : values)
+        if (static_cast<T>(decoder.next()) != value) return false;
+    return true;
+}
+
+/** \brief raw bits of floating point values */
+template <typename Float, typename Bits>
+static std::vector<uint64_t> float_bits(std::initializer_list<Float> values) {
+    std::vector<uint64_t> bits;
+    for (const auto value : values) {
+        Bits raw;
+        memcpy(&raw, &value, sizeof(raw));
+        bits.push_back(raw);
+    }
+    return bits;
+}
+
 int main() {
     // create shared memories
     cxxshm::SharedMemory shm_ao("modbus_AO", 4096, false, true);
@@ -102,5 +181,678 @@ int main() {
         }
     }
 
+    {  // test 4
+        const int         EXPECT_EXIT = 0;
+        const std::string EXPECT_OUT  = "do:0:1\n"
+                                        "do:1:0\n"
+                                        "ao:0:x16l:42ff\n"  // FIXME: will fail on big endian arch
+                                       "ao:2:f32l:3.141\n"
+                                       "ao:4:x16b:42ff\n";
+
+        std::pair<std::string, int> result =
+                exec("../modbus-shm-to-stdout ../../test/test_signals.txt -s --float-format shortest");
+        if (result.second != EXPECT_EXIT) {
+            std::cerr << "test 4: wrong exit code" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (result.first != EXPECT_OUT) {
+            std::cerr << "test 4: wrong output: >>" << result.first << "<<" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    {  // test 5 (file output)
+        const int         EXPECT_EXIT = 0;
+        const std::string EXPECT_OUT  = "do:0:1\n"
+                                        "do:1:0\n"
+                                        "ao:0:x16l:42ff\n"  // FIXME: will fail on big endian arch
+                                       "ao:2:f32l:3.141000e+00\n"
+                                       "ao:4:x16b:42ff\n";
+
+        std::remove("test_output.txt");
+        std::pair<std::string, int> result =
+                exec("../modbus-shm-to-stdout ../../test/test_signals.txt -s -o test_output.txt");
+        if (result.second != EXPECT_EXIT) {
+            std::cerr << "test 5: wrong exit code" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::ifstream     file("test_output.txt");
+        std::stringstream file_content;
+        file_content << file.rdbuf();
+        if (file_content.str() != EXPECT_OUT) {
+            std::cerr << "test 5: wrong output: >>" << file_content.str() << "<<" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    {  // test 6 (change notification, the child process acts as modbus client)
+        const int         EXPECT_EXIT = 0;
+        const std::string EXPECT_OUT  = "do:0:1\n"
+                                        "do:1:0\n"
+                                        "ao:0:x16l:42ff\n"  // FIXME: will fail on big endian arch
+                                       "ao:2:f32l:3.141000e+00\n"
+                                       "ao:4:x16b:42ff\n"
+                                       "ao:4:x16b:3412\n";
+
+        cxxshm::SharedMemory shm_notify("modbus_notify", 64, false, true);
+
+        const pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "test 6: fork failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (pid == 0) {
+            usleep(500000);
+            shm_ao.at<uint16_t>(4) = 0x1234;
+            ChangeNotifier("modbus_notify").notify();
+            _exit(EXIT_SUCCESS);
+        }
+
+        // the cycle time is much longer than the test: the change must be output because of the notification
+        std::pair<std::string, int> result = exec(
+                "timeout --preserve-status -s INT 2 ../modbus-shm-to-stdout ../../test/test_signals.txt -e -c 60000 "
+                "--notify");
+        waitpid(pid, nullptr, 0);
+        if (result.second != EXPECT_EXIT) {
+            std::cerr << "test 6: wrong exit code" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (result.first != EXPECT_OUT) {
+            std::cerr << "test 6: wrong output: >>" << result.first << "<<" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    {  // test 7 (replay in event mode: the initial state is the first record, an unchanged recording has no events)
+        shm_do.at<uint8_t>(0)  = 1;
+        shm_ao.at<uint16_t>(0) = 5;
+        shm_ao.at<uint16_t>(1) = 7;
+        write_file("test_replay_signals.txt", "do:0\nao:0:u16l\nao:1:u16l\n");
+
+        std::remove("test_replay.rec");
+        auto result = exec("timeout --preserve-status -s INT 1.15 ../modbus-shm-to-stdout test_replay_signals.txt "
+                           "-c 100 --record test_replay.rec");
+        if (!check("test 7 (record)", result, EXIT_SUCCESS, "")) return EXIT_FAILURE;
+
+        result = exec("../modbus-shm-to-stdout test_replay_signals.txt -e --replay test_replay.rec --replay-speed fast "
+                      "2>/dev/null");
+        if (!check("test 7", result, EXIT_SUCCESS, "do:0:1\nao:0:u16l:5\nao:1:u16l:7\n")) return EXIT_FAILURE;
+    }
+
+    {  // test 8 (aggregation: min/max of 64 bit integers are exact, NaN samples are ignored)
+        for (std::size_t i = 8; i < 12; ++i)
+            shm_ao.at<uint16_t>(i) = 0xFFFF;
+        shm_ao.at<uint16_t>(12) = 1;
+        shm_ao.at<uint16_t>(13) = 0;
+        shm_ao.at<uint16_t>(14) = 0;
+        shm_ao.at<uint16_t>(15) = 0x8000;
+        shm_ao.at<float>(8)     = std::numeric_limits<float>::quiet_NaN();  // registers 16 and 17
+        write_file("test_aggregate_signals.txt", "ao:8:u64l\nao:12:i64l\nao:16:f32l\n");
+
+        auto result = exec("../modbus-shm-to-stdout test_aggregate_signals.txt -c 10 --aggregate 100 | head -n 3");
+        if (!check("test 8",
+                   result,
+                   EXIT_SUCCESS,
+                   "ao:8:u64l:18446744073709551615:18446744073709551615:18446744073709551615:1.844674407370955e+19:10\n"
+                   "ao:12:i64l:-9223372036854775807:-9223372036854775807:-9223372036854775807:"
+                   "-9.223372036854776e+18:10\n"
+                   "ao:16:f32l:nan:nan:nan:nan:0\n"))  // NaN samples are not aggregated
+            return EXIT_FAILURE;
+
+        // the mean of a window with NaN and valid samples is the mean of the valid samples (2.5f: 0x40200000)
+        shm_ao.at<float>(9) = std::numeric_limits<float>::quiet_NaN();  // registers 18 and 19
+        write_file("test_aggregate_signals.txt", "ao:18:f32l\n");
+        result = exec("(sleep 0.2; printf '\\000\\000\\040\\100' | dd of=/dev/shm/modbus_AO bs=1 seek=36 "
+                      "conv=notrunc 2>/dev/null) & ../modbus-shm-to-stdout test_aggregate_signals.txt -c 10 "
+                      "--aggregate 1000 | head -n 1 | cut -d : -f 1-7");
+        if (!check("test 8 (NaN samples)",
+                   result,
+                   EXIT_SUCCESS,
+                   "ao:18:f32l:2.500000e+00:2.500000e+00:2.500000e+00:2.500000000000000e+00\n"))
+            return EXIT_FAILURE;
+    }
+
+    {  // test 9 (conditions)
+        shm_do.at<uint8_t>(20) = 1;
+        shm_do.at<uint8_t>(21) = 1;
+        shm_do.at<uint8_t>(22) = 0;
+        shm_do.at<uint8_t>(23) = 0;
+        write_file("test_condition_signals.txt", "ao:0:u16l\n");
+
+        static const std::pair<const char *, bool> CONDITIONS[] = {
+                {"do:20", true},                                      // coil as boolean
+                {"!do:22", true},
+                {"do:20 == do:21", true},                             // boolean comparison
+                {"do:20 || do:21 && do:22", true},                    // && before ||
+                {"(do:20 || do:21) && do:22", false},
+                {"!do:20 && ao:0:u16l > 3 || do:21", true},           // && short-circuits, then ||
+                {"do:20 || ao:0:u16l > 3 && do:22", true},            // || short-circuits the rest
+                {"do:22 && do:23 || do:23 && do:20", false},
+                {"ao:0:u16l + 2 * 3 == 11 && -ao:0:u16l < 0", true},  // * before +
+                {"(ao:0:u16l + 2) * 3 == 21", true},
+        };
+        for (const auto &[condition, expected] : CONDITIONS) {
+            const auto command = std::string("../modbus-shm-to-stdout test_condition_signals.txt --single ") +
+                                 "--condition '" + condition + '\'';
+            const auto result  = exec(command.c_str());
+            const auto *output = expected ? "ao:0:u16l:5\n" : "";
+            if (!check(std::string("test 9 (") + condition + ')', result, EXIT_SUCCESS, output)) return EXIT_FAILURE;
+        }
+
+        // type errors are rejected at startup
+        static const std::pair<const char *, const char *> INVALID[] = {
+                {"do:20 > 1", "at position 10: > requires a numeric operand"},
+                {"do:20 + 1 == 2", "at position 8: + requires a numeric operand"},
+                {"ao:0:u16l && do:20", "at position 13: && requires a boolean operand"},
+                {"ai:0:f99 > 1", "at position 1: unknown data type string"},
+                {"ao:5000:u16l > 1", "at position 1: index out of range"},
+        };
+        for (const auto &[condition, message] : INVALID) {
+            const auto command = std::string("../modbus-shm-to-stdout test_condition_signals.txt --single ") +
+                                 "--condition '" + condition + "' 2>&1";
+            const auto result  = exec(command.c_str());
+            if (!check(std::string("test 9 (") + condition + ')',
+                       result,
+                       EX_DATAERR,
+                       std::string("invalid expression '") + condition + "' " + message + '\n'))
+                return EXIT_FAILURE;
+        }
+
+        // cycles are suppressed while the condition is false: the first output is the first cycle after do:24 is set
+        shm_do.at<uint8_t>(24) = 0;
+        write_file("test_condition_signals.txt", "do:24\n");
+        const auto result = exec("(sleep 0.2; printf '\\001' | dd of=/dev/shm/modbus_DO bs=1 seek=24 conv=notrunc "
+                                 "2>/dev/null) & ../modbus-shm-to-stdout test_condition_signals.txt -c 10 "
+                                 "--condition 'do:24' | head -n 1");
+        if (!check("test 9 (cyclic)", result, EXIT_SUCCESS, "do:24:1\n")) return EXIT_FAILURE;
+    }
+
+    {  // test 10 (coil groups: groups of 64 consecutive coils, a change at the boundary affects two groups)
+        std::string signals;
+        std::string expected;
+        for (std::size_t i = 300; i < 430; ++i) {
+            shm_do.at<uint8_t>(i) = i == 301;
+            signals += "do:" + std::to_string(i) + '\n';
+            expected += "do:" + std::to_string(i) + (i == 301 ? ":1\n" : ":0\n");
+        }
+        write_file("test_coil_group_signals.txt", signals);
+
+        // coils 363 (last of the first group) and 364 (first of the second group) are set, the third group is unchanged
+        expected += "do:300..363:8000000000000002\n"
+                    "do:364..427:1\n";
+        const auto result = exec("(sleep 0.3; printf '\\001\\001' | dd of=/dev/shm/modbus_DO bs=1 seek=363 "
+                                 "conv=notrunc 2>/dev/null) & timeout --preserve-status -s INT 0.6 "
+                                 "../modbus-shm-to-stdout test_coil_group_signals.txt -e -c 10 --coil-groups");
+        if (!check("test 10", result, EXIT_SUCCESS, expected)) return EXIT_FAILURE;
+    }
+
+    {  // test 11 (archive codec: edge cases of the column encodings)
+        // negative and large delta of delta, the clock jumps back
+        const std::vector<int64_t> timestamps = {1700000000000000,
+                                                 1700000000010000,
+                                                 1700000000020000,
+                                                 1700000000025000,
+                                                 1700000000030001,
+                                                 1700000009000000,
+                                                 1700000000000000,
+                                                 1700000000000100,
+                                                 1700000000000100};
+        if (!archive_round_trip<archive::TimestampDecoder>(archive::TimestampEncoder(), timestamps)) {
+            std::cerr << "test 11: time stamp round trip failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // differences that overflow int64_t
+        const std::vector<uint64_t> integers = {0,
+                                                std::numeric_limits<uint64_t>::max(),
+                                                1,
+                                                0x8000000000000000,
+                                                0x7FFFFFFFFFFFFFFF,
+                                                0x7FFFFFFFFFFFFFFF,
+                                                0};
+        if (!archive_round_trip<archive::IntegerDecoder>(archive::IntegerEncoder(), integers)) {
+            std::cerr << "test 11: integer round trip failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        constexpr auto INF = std::numeric_limits<double>::infinity();
+        const auto     f64 = float_bits<double, uint64_t>({1.5, NAN, INF, -INF, -0.0, 0.0, 1e-300, 1e-300, 1e300});
+        const auto     f32 = float_bits<float, uint32_t>({1.5f, NAN, INFINITY, -INFINITY, -0.0f, 0.0f, 1e-40f, 3e38f});
+        if (!archive_round_trip<archive::FloatDecoder>(archive::FloatEncoder(64), f64, 64u) ||
+            !archive_round_trip<archive::FloatDecoder>(archive::FloatEncoder(32), f32, 32u)) {
+            std::cerr << "test 11: float round trip failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    {  // test 12 (archive: --read-archive matches the cyclic output of the same recording, also without index)
+        write_file("test_archive_signals.txt",
+                   "ao:40:u64l\nao:44:i64l\nao:48:f32l\nao:50:f64l\nao:54:i16l:scale=0.01:offset=-40\ndo:40\n");
+
+        // the child process writes edge cases while the values are recorded
+        const pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "test 12: fork failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (pid == 0) {
+            static constexpr uint64_t U64[] = {0, std::numeric_limits<uint64_t>::max(), 1, 0x8000000000000000};
+            static constexpr int64_t  I64[] = {std::numeric_limits<int64_t>::min(), -1, 0, 1};
+            static constexpr float    F32[] = {NAN, INFINITY, -INFINITY, 1.5f};
+            static constexpr double   F64[] = {-INFINITY, NAN, -0.0, 1e300};
+            static constexpr int16_t  I16[] = {-32768, 32767, 0, 1234};
+            for (std::size_t i = 0; i < 200; ++i) {
+                memcpy(&shm_ao.at<uint16_t>(40), &U64[i % 4], sizeof(uint64_t));
+                memcpy(&shm_ao.at<uint16_t>(44), &I64[(i / 2) % 4], sizeof(int64_t));
+                memcpy(&shm_ao.at<uint16_t>(48), &F32[(i / 3) % 4], sizeof(float));
+                memcpy(&shm_ao.at<uint16_t>(50), &F64[i % 4], sizeof(double));
+                memcpy(&shm_ao.at<uint16_t>(54), &I16[(i / 5) % 4], sizeof(int16_t));
+                shm_do.at<uint8_t>(40) = i % 7 == 0;
+                usleep(4000);
+            }
+            _exit(EXIT_SUCCESS);
+        }
+
+        std::remove("test_archive.rec");
+        auto result = exec("timeout --preserve-status -s INT 0.6 ../modbus-shm-to-stdout test_archive_signals.txt "
+                           "-c 10 --record test_archive.rec");
+        waitpid(pid, nullptr, 0);
+        if (!check("test 12 (record)", result, EXIT_SUCCESS, "")) return EXIT_FAILURE;
+
+        const auto cyclic = exec("../modbus-shm-to-stdout test_archive_signals.txt --replay test_archive.rec "
+                                 "--replay-speed fast 2>/dev/null");
+        if (cyclic.first.find("18446744073709551615") == std::string::npos ||
+            cyclic.first.find("nan") == std::string::npos || cyclic.first.find("-inf") == std::string::npos) {
+            std::cerr << "test 12: edge cases not recorded: >>" << cyclic.first << "<<" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // small blocks: the archive contains multiple blocks
+        std::remove("test_archive.arc");
+        result = exec("../modbus-shm-to-stdout test_archive_signals.txt --replay test_archive.rec --replay-speed fast "
+                      "--archive test_archive.arc --archive-block 16 2>/dev/null");
+        if (!check("test 12 (archive)", result, EXIT_SUCCESS, "")) return EXIT_FAILURE;
+
+        result = exec("../modbus-shm-to-stdout --read-archive test_archive.arc");
+        if (!check("test 12", result, EXIT_SUCCESS, cyclic.first)) return EXIT_FAILURE;
+
+        // an archive that was not closed properly ends after the last block (no index and trailer)
+        std::ifstream     file("test_archive.arc", std::ios::binary);
+        std::stringstream content;
+        content << file.rdbuf();
+        auto archive = content.str();
+
+        archive_trailer_t trailer {};
+        memcpy(&trailer, archive.data() + archive.size() - sizeof(trailer), sizeof(trailer));
+        archive.resize(trailer.index_offset);
+        write_file("test_archive_no_index.arc", archive);
+
+        result = exec("../modbus-shm-to-stdout --read-archive test_archive_no_index.arc 2>/dev/null");
+        if (!check("test 12 (no index)", result, EXIT_SUCCESS, cyclic.first)) return EXIT_FAILURE;
+        result = exec("../modbus-shm-to-stdout --read-archive test_archive_no_index.arc 2>&1 >/dev/null");
+        if (!check("test 12 (no index warning)",
+                   result,
+                   EXIT_SUCCESS,
+                   "WARNING: archive was not closed properly (no block index)\n"))
+            return EXIT_FAILURE;
+    }
+
+    {  // test 13 (scaling: clamping to min/max, NaN is not clamped, coils can not be scaled)
+        const int16_t raw_i16[] = {-500, -10};
+        const float   raw_f32[] = {NAN, 50.0f};
+        memcpy(&shm_ao.at<uint16_t>(60), &raw_i16[0], sizeof(int16_t));
+        shm_ao.at<uint16_t>(61) = 2000;
+        memcpy(&shm_ao.at<uint16_t>(62), &raw_i16[1], sizeof(int16_t));
+        memcpy(&shm_ao.at<uint16_t>(64), &raw_f32[0], sizeof(float));
+        memcpy(&shm_ao.at<uint16_t>(66), &raw_f32[1], sizeof(float));
+        write_file("test_scaling_signals.txt",
+                   "ao:60:i16l:scale=0.01:offset=-40\n"
+                   "ao:61:u16l:scale=0.1:min=0:max=100\n"
+                   "ao:62:i16l:scale=0.1:min=0\n"
+                   "ao:64:f32l:scale=2:min=0:max=10\n"
+                   "ao:66:f32l:scale=0.5:min=0:max=10\n");
+
+        auto result = exec("../modbus-shm-to-stdout test_scaling_signals.txt -s");
+        if (!check("test 13",
+                   result,
+                   EXIT_SUCCESS,
+                   "ao:60:i16l:-4.500000000000000e+01\n"
+                   "ao:61:u16l:1.000000000000000e+02\n"
+                   "ao:62:i16l:0.000000000000000e+00\n"
+                   "ao:64:f32l:nan\n"
+                   "ao:66:f32l:1.000000000000000e+01\n"))
+            return EXIT_FAILURE;
+
+        for (const auto *line : {"do:0:bit:scale=2", "di:3:bit:min=0"}) {
+            write_file("test_scaling_signals.txt", std::string(line) + '\n');
+            result = exec("../modbus-shm-to-stdout test_scaling_signals.txt -s 2>&1");
+            if (!check(std::string("test 13 (") + line + ')',
+                       result,
+                       EX_DATAERR,
+                       std::string("Failed to parse line 1 (") + line + "): coils can not be scaled\n"))
+                return EXIT_FAILURE;
+        }
+    }
+
+    {  // test 14 (influx line protocol: escaping, tags, one line per series, per chunk lines with --threads)
+        const float    temp = 22.99f;
+        const int16_t  i16  = -3;
+        const uint64_t u64  = 128;
+        const float    nan  = NAN;
+        shm_ao.at<uint16_t>(70) = 49;
+        memcpy(&shm_ao.at<uint16_t>(71), &temp, sizeof(float));
+        memcpy(&shm_ao.at<uint16_t>(73), &i16, sizeof(int16_t));
+        memcpy(&shm_ao.at<uint16_t>(74), &u64, sizeof(uint64_t));
+        memcpy(&shm_ao.at<uint16_t>(78), &nan, sizeof(float));
+        shm_do.at<uint8_t>(73) = 1;
+        write_file("test_influx_signals.txt",
+                   "ao:70:u16l:tags=device=pump 1,site=B\n"
+                   "ao:71:f32l:tags=site=B,device=pump 1:field=temp\n"
+                   "ao:73:i16l:measurement=my,plant x:tags=my key=a=b:field=f,g h=i\n"
+                   "ao:74:u64l\n"
+                   "do:73\n"
+                   "ao:78:f32l\n");
+
+        // the time stamp (last field) differs per run
+        auto result = exec("../modbus-shm-to-stdout test_influx_signals.txt -s --influx plant "
+                           "--influx-tags site=A,area=north | sed 's/ [0-9]*$//'");
+        if (!check("test 14",
+                   result,
+                   EXIT_SUCCESS,
+                   "plant,area=north,device=pump\\ 1,site=B ao:70:u16l=49i,temp=2.299000e+01\n"
+                   "my\\,plant\\ x,area=north,my\\ key=a\\=b,site=A f\\,g\\ h\\=i=-3i\n"
+                   "plant,area=north,site=A ao:74:u64l=128u,do:73=true\n"))
+            return EXIT_FAILURE;
+
+        // chunks of 2 signals: the series of ao:74 and do:73 is split at the chunk boundary
+        result = exec("../modbus-shm-to-stdout test_influx_signals.txt -c 10 --threads 2 --chunk-size 2 --influx plant "
+                      "--influx-tags site=A,area=north | head -n 4 | sed 's/ [0-9]*$//'");
+        if (!check("test 14 (threads)",
+                   result,
+                   EXIT_SUCCESS,
+                   "plant,area=north,device=pump\\ 1,site=B ao:70:u16l=49i,temp=2.299000e+01\n"
+                   "my\\,plant\\ x,area=north,my\\ key=a\\=b,site=A f\\,g\\ h\\=i=-3i\n"
+                   "plant,area=north,site=A ao:74:u64l=128u\n"
+                   "plant,area=north,site=A do:73=true\n"))
+            return EXIT_FAILURE;
+    }
+
+    {  // test 15 (event ring: a second process reads the keyframe and the changes)
+        const int16_t raw = 10;
+        shm_ao.at<uint16_t>(80) = 7;
+        memcpy(&shm_ao.at<uint16_t>(81), &raw, sizeof(int16_t));
+        shm_do.at<uint8_t>(80) = 0;
+        write_file("test_ring_signals.txt", "ao:80:u16l\ndo:80\nao:81:i16l:scale=0.5\n");
+        std::remove("/dev/shm/test_ring");
+
+        const pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "test 15: fork failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (pid == 0) {
+            execl("../modbus-shm-to-stdout",
+                  "modbus-shm-to-stdout",
+                  "test_ring_signals.txt",
+                  "-e",
+                  "-c",
+                  "10",
+                  "--event-ring",
+                  "test_ring",
+                  nullptr);
+            _exit(EXIT_FAILURE);
+        }
+
+        // wait until the ring is created and initialized
+        std::unique_ptr<cxxshm::SharedMemory> ring;
+        const event_ring_header_t            *header = nullptr;
+        for (int i = 0; i < 200; ++i) {
+            try {
+                ring   = std::make_unique<cxxshm::SharedMemory>("test_ring", true);
+                header = ring->get_addr<const event_ring_header_t *>();
+                if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == EVENT_RING_MAGIC) break;
+            } catch (const std::exception &) {}
+            header = nullptr;
+            usleep(10000);
+        }
+        if (!header) {
+            std::cerr << "test 15: event ring not created" << std::endl;
+            kill(pid, SIGINT);
+            waitpid(pid, nullptr, 0);
+            return EXIT_FAILURE;
+        }
+
+        const auto *base        = ring->get_addr<const uint8_t *>();
+        const auto *descriptors = reinterpret_cast<const shm_table_descriptor_t *>(base + header->descriptor_offset);
+        const auto *slots       = reinterpret_cast<const event_record_t *>(base + header->record_offset);
+
+        // reader protocol of EventRing.hpp
+        struct record_t {
+            uint32_t signal;
+            uint32_t flags;
+            uint64_t value;
+        };
+        std::vector<record_t> records;
+        uint64_t              cursor       = 1;
+        auto                  read_records = [&](uint64_t last) {
+            for (int i = 0; i < 200 && cursor <= last; ++i) {
+                const auto head = header->head.load(std::memory_order_acquire);
+                for (; cursor <= head; ++cursor) {
+                    const auto &slot = slots[cursor & (header->capacity - 1)];
+                    const auto  s1   = slot.sequence.load(std::memory_order_acquire);
+                    record_t    record {slot.signal, slot.flags, slot.value};
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (s1 != cursor || slot.sequence.load(std::memory_order_relaxed) != cursor) return false;
+                    records.push_back(record);
+                }
+                usleep(10000);
+            }
+            return cursor > last;
+        };
+
+        // keyframe of all signals, then the changes in the order they were written
+        const bool keyframe_read = read_records(3);
+        shm_ao.at<uint16_t>(80) = 8;
+        shm_do.at<uint8_t>(80)  = 1;
+        const bool changes_read = read_records(5);
+
+        kill(pid, SIGINT);
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            std::cerr << "test 15: wrong exit code" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (!keyframe_read || !changes_read || records.size() != 5) {
+            std::cerr << "test 15: records missing or overwritten" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (header->signal_count != 3 || descriptors[0].register_type != 2 || descriptors[0].index != 80 ||
+            strcmp(descriptors[0].label, "u16l") != 0 || descriptors[1].register_type != 0 ||
+            descriptors[1].index != 80 || descriptors[2].value_kind != 4) {
+            std::cerr << "test 15: wrong descriptors" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        static constexpr record_t EXPECTED[] = {
+                {0, EVENT_RECORD_KEYFRAME, 7},
+                {1, EVENT_RECORD_KEYFRAME, 0},
+                {2, EVENT_RECORD_KEYFRAME, 0x4014000000000000},  // 5.0 (scaled)
+                {0, 0, 8},
+                {1, 0, 1},
+        };
+        for (std::size_t i = 0; i < records.size(); ++i) {
+            const auto &record = records[i];
+            if (record.signal != EXPECTED[i].signal || record.flags != EXPECTED[i].flags ||
+                record.value != EXPECTED[i].value) {
+                std::cerr << "test 15: wrong record " << i + 1 << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    {  // test 16 (state file: after a restart only the differences to the stored state are written)
+        shm_ao.at<uint16_t>(90) = 0;
+        shm_ao.at<uint16_t>(91) = 0;
+        shm_do.at<uint8_t>(90)  = 0;
+        write_file("test_state_signals.txt", "ao:90:u16l\nao:91:u16l\ndo:90\n");
+        std::remove("test_state.bin");
+
+        const char *command = "timeout --preserve-status -s INT 0.3 ../modbus-shm-to-stdout test_state_signals.txt "
+                              "-e -c 10 --state-file test_state.bin 2>/dev/null";
+        auto        result  = exec(command);
+        if (!check("test 16 (initial)", result, EXIT_SUCCESS, "ao:90:u16l:0\nao:91:u16l:0\ndo:90:0\n"))
+            return EXIT_FAILURE;
+
+        // changes while the application is not running
+        shm_ao.at<uint16_t>(91) = 5;
+        shm_do.at<uint8_t>(90)  = 1;
+        result = exec(command);
+        if (!check("test 16 (restart)", result, EXIT_SUCCESS, "ao:91:u16l:5\ndo:90:1\n")) return EXIT_FAILURE;
+
+        result = exec(command);
+        if (!check("test 16 (unchanged)", result, EXIT_SUCCESS, "")) return EXIT_FAILURE;
+
+        // a state that was being modified (stopped during a cycle) is discarded: all signals are written again
+        {
+            std::fstream   file("test_state.bin", std::ios::in | std::ios::out | std::ios::binary);
+            const uint32_t valid = 0;
+            file.seekp(offsetof(state_file_header_t, valid));
+            file.write(reinterpret_cast<const char *>(&valid), sizeof(valid));
+        }
+        result = exec(command);
+        if (!check("test 16 (interrupted)", result, EXIT_SUCCESS, "ao:90:u16l:0\nao:91:u16l:5\ndo:90:1\n"))
+            return EXIT_FAILURE;
+
+        // the state of a different signal list is discarded
+        write_file("test_state_signals.txt", "ao:90:u16l\nao:91:u16l\n");
+        result = exec(command);
+        if (!check("test 16 (signal list changed)", result, EXIT_SUCCESS, "ao:90:u16l:0\nao:91:u16l:5\n"))
+            return EXIT_FAILURE;
+    }
+
+    {  // test 17 (file sink: output is dropped in complete cycles if all buffers are in use)
+        std::remove("test_sink.txt");
+        {
+            // two buffers of 16 bytes: the second cycle does not fit into the buffers, the third fits into one
+            FileSink     sink("test_sink.txt", 0, std::chrono::milliseconds(0), 16, 2);
+            std::ostream out(&sink);
+            out << "cycle 1\n" << std::flush;
+            out << "cycle 2: 0123456789\ncycle 2: 0123456789\n" << std::flush;
+            out << "cycle 3\n" << std::flush;
+        }
+
+        std::ifstream     file("test_sink.txt");
+        std::stringstream content;
+        content << file.rdbuf();
+        if (content.str() != "cycle 1\ncycle 3\n") {
+            std::cerr << "test 17: wrong output: >>" << content.str() << "<<" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    {  // test 18 (signal groups: each group is output at its own cycle time, due groups together)
+        shm_ao.at<uint16_t>(20) = 1;
+        shm_ao.at<uint16_t>(21) = 2;
+        write_file("test_group_signals.txt", "@cycle 50\nao:20:u16l\n@cycle 150\nao:21:u16l\n");
+
+        // 0 ms: both groups, 50 ms, 100 ms: first group, 150 ms: both groups
+        const auto result = exec("../modbus-shm-to-stdout test_group_signals.txt | head -n 6");
+        if (!check("test 18",
+                   result,
+                   EXIT_SUCCESS,
+                   "ao:20:u16l:1\nao:21:u16l:2\nao:20:u16l:1\nao:20:u16l:1\nao:20:u16l:1\nao:21:u16l:2\n"))
+            return EXIT_FAILURE;
+    }
+
+    {  // test 19 (keyframes: the state of all signals is written periodically, independent of the cycle time)
+        shm_ao.at<uint16_t>(22) = 7;
+        write_file("test_keyframe_signals.txt", "ao:22:u16l\n");
+        const auto result =
+                exec("../modbus-shm-to-stdout test_keyframe_signals.txt -e -c 30 --keyframe 100 | head -n 3");
+        if (!check("test 19", result, EXIT_SUCCESS, "ao:22:u16l:7\nkf:ao:22:u16l:7\nkf:ao:22:u16l:7\n"))
+            return EXIT_FAILURE;
+    }
+
+    {  // test 20 (query daemon: signal list, signal set, ad-hoc request with scaling, error reply)
+        shm_ao.at<uint16_t>(24) = 3;
+        shm_ao.at<uint16_t>(25) = 4;
+        shm_ao.at<uint16_t>(26) = 9;
+        write_file("test_query_signals.txt", "ao:24:u16l\n");
+        write_file("test_query_set.txt", "ao:25:u16l\n");
+
+        const pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "test 20: fork failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (pid == 0) {
+            execl("../modbus-shm-to-stdout",
+                  "modbus-shm-to-stdout",
+                  "test_query_signals.txt",
+                  "--serve",
+                  "test_query.sock",
+                  "--signal-set",
+                  "extra=test_query_set.txt",
+                  nullptr);
+            _exit(EXIT_FAILURE);
+        }
+
+        // wait until the server accepts connections
+        sockaddr_un addr {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, "test_query.sock", sizeof(addr.sun_path) - 1);
+        int fd = -1;
+        for (int i = 0; i < 200 && fd < 0; ++i) {
+            fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+                close(fd);
+                fd = -1;
+                usleep(10000);
+            }
+        }
+
+        // one reply per request, each terminated by an empty line
+        std::string reply;
+        if (fd >= 0) {
+            timeval timeout {2, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            const std::string requests = "@\n@extra\nao:26:u16l:scale=0.5\nao:x\n";
+            if (send(fd, requests.data(), requests.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(requests.size())) {
+                char buffer[4096];
+                for (std::size_t replies = 0; replies < 4;) {
+                    const auto ret = recv(fd, buffer, sizeof(buffer), 0);
+                    if (ret <= 0) break;
+                    reply.append(buffer, static_cast<std::size_t>(ret));
+                    replies = 0;
+                    for (auto pos = reply.find("\n\n"); pos != std::string::npos; pos = reply.find("\n\n", pos + 1))
+                        ++replies;
+                }
+            }
+            close(fd);
+        }
+
+        kill(pid, SIGINT);
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (fd < 0) {
+            std::cerr << "test 20: failed to connect" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!check("test 20",
+                   {reply, status},
+                   EXIT_SUCCESS,
+                   "ao:24:u16l:3\n\n"
+                   "ao:25:u16l:4\n\n"
+                   "ao:26:u16l:4.500000000000000e+00\n\n"
+                   "error:ao:x: invalid register index format\n\n"))
+            return EXIT_FAILURE;
+    }
+
     return EXIT_SUCCESS;
 }